@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+/* the most strictly aligned types, every allocation is aligned like this union (its size is a
+   multiple of its alignment, 16 bytes on x86-64) */
+typedef union arena_align {
+  long double ld;
+  long long ll;
+  void *ptr;
+  void (*fn)(void);
+} arena_align_t;
+#define ARENA_ALIGN (sizeof(arena_align_t))
+
+/* one block of memory, allocated from the front, the newest chunk is at the head */
+typedef struct arena_chunk {
+  struct arena_chunk *next;
+  size_t size;
+  size_t used;
+  arena_align_t data[];
+} arena_chunk_t;
+
+/* last is the latest allocation, the only one that can grow in place */
+struct arena {
+  arena_chunk_t *head;
+  void *last;
+};
+
+/* allocates a chunk with room for size bytes, returns NULL on failure */
+static arena_chunk_t *new_chunk(size_t size){
+  arena_chunk_t *chunk = (arena_chunk_t *) malloc(sizeof(arena_chunk_t) + size);
+  if (chunk == NULL){
+    return NULL;
+  }
+  chunk->next = NULL;
+  chunk->size = size;
+  chunk->used = 0;
+  return chunk;
+}
+
+/* rounds size up to a multiple of ARENA_ALIGN */
+static size_t align_up(size_t size){
+  return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+arena_t *init_arena(size_t size){
+  arena_t *arena = (arena_t *) malloc(sizeof(arena_t));
+  if (arena == NULL){
+    return NULL;
+  }
+  if ((arena->head = new_chunk(align_up(size))) == NULL){
+    free(arena);
+    return NULL;
+  }
+  arena->last = NULL;
+  return arena;
+}
+
+void cleanup_arena(arena_t *arena){
+  if (arena == NULL){
+    return;
+  }
+  arena_chunk_t *chunk = arena->head;
+  while (chunk != NULL){
+    arena_chunk_t *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  free(arena);
+}
+
+void *arena_alloc(arena_t *arena, size_t size){
+  size = align_up(size);
+  arena_chunk_t *chunk = arena->head;
+  if (chunk->size - chunk->used < size){
+    /* a new chunk at least twice as big as the last one, so a long line takes few of them */
+    size_t chunk_size = chunk->size * 2;
+    if (chunk_size < size){
+      chunk_size = size;
+    }
+    if ((chunk = new_chunk(chunk_size)) == NULL){
+      return NULL;
+    }
+    chunk->next = arena->head;
+    arena->head = chunk;
+  }
+  void *ptr = (unsigned char *) chunk->data + chunk->used;
+  chunk->used += size;
+  arena->last = ptr;
+  return ptr;
+}
+
+void *arena_grow(arena_t *arena, void *ptr, size_t old_size, size_t new_size){
+  arena_chunk_t *chunk = arena->head;
+  if (ptr != NULL && ptr == arena->last){
+    size_t offset = (size_t) ((unsigned char *) ptr - (unsigned char *) chunk->data);
+    if (chunk->size - offset >= align_up(new_size)){
+      chunk->used = offset + align_up(new_size);
+      return ptr;
+    }
+  }
+  void *grown = arena_alloc(arena, new_size);
+  if (grown != NULL && ptr != NULL){
+    memcpy(grown, ptr, old_size);
+  }
+  return grown;
+}
+
+void reset_arena(arena_t *arena){
+  arena_chunk_t *chunk = arena->head;
+  arena->last = NULL;
+  if (chunk->next == NULL){
+    chunk->used = 0;
+    return;
+  }
+  size_t total = 0;
+  for (arena_chunk_t *cur = chunk; cur != NULL; cur = cur->next){
+    total += cur->size;
+  }
+  /* if the merged chunk can't be had, the newest chunk (the biggest) is kept instead */
+  arena_chunk_t *merged = new_chunk(total);
+  if (merged == NULL){
+    merged = chunk;
+    chunk = chunk->next;
+    merged->next = NULL;
+    merged->used = 0;
+  }
+  while (chunk != NULL){
+    arena_chunk_t *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  arena->head = merged;
+}
@@ -0,0 +1,36 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <stddef.h>
+
+typedef struct arena arena_t;
+
+/* initializes an arena with a first chunk of size bytes, returns pointer on success, NULL on
+   failure */
+arena_t *init_arena(size_t size);
+
+/*
+ * cleans up the arena and everything allocated from it
+ * Note: this function will free the arena pointer
+ */
+void cleanup_arena(arena_t *arena);
+
+/* allocates size bytes, aligned for any type, which stay valid until the arena is reset,
+   returns pointer on success, NULL on failure */
+void *arena_alloc(arena_t *arena, size_t size);
+
+/*
+ * grows an allocation from old_size to new_size bytes, in place if it is the latest one and its
+ * chunk has room, and by copying it to a new allocation otherwise
+ * returns the (possibly moved) allocation on success, NULL on failure (ptr stays valid then)
+ */
+void *arena_grow(arena_t *arena, void *ptr, size_t old_size, size_t new_size);
+
+/*
+ * frees everything allocated from the arena at once, keeping its memory for the next use
+ * if it took more than one chunk, they are merged into a single chunk of their total size, so an
+ * arena that is reset often settles on one chunk and then never goes to malloc
+ */
+void reset_arena(arena_t *arena);
+
+#endif  // ARENA_H_
@@ -0,0 +1,27 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * Shared by the benchmarks: every result is printed as one JSON object per line, e.g.
+ *   {"bench":"lex","n":64,"metric":"new_ns_per_line","value":812.4}
+ * so that "make bench > results.jsonl" can be compared between builds by a script.
+ */
+
+/* the monotonic clock in seconds */
+static inline double bench_now(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* prints one result, n being the size the benchmark was run at (words, jobs, commands...) */
+static inline void bench_report(const char* bench, long n, const char* metric, double value){
+  printf("{\"bench\":\"%s\",\"n\":%ld,\"metric\":\"%s\",\"value\":%.3f}\n", bench, n, metric,
+    value);
+  fflush(stdout);
+}
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * jobs_bench - times the job table operations the REPL makes for every job (adding and removing a
+ * job, looking one up by JID and by PID, changing its state, reaping its process), with the table
+ * already holding 10, 100, 1000 and 10000 other jobs, printed as JSON lines (see bench.h)
+ *
+ * The PIDs are made up and above any pid_max, so pidfd_open() fails at once and every job counts
+ * as untracked, the failed system call is part of the cost of add_job() as it is in the shell.
+ *
+ * usage: jobs_bench [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "../jobs.h"
+#include "bench.h"
+
+/* above the largest pid_max the kernel allows (2^22) */
+#define FAKE_PID(i) ((pid_t) ((1 << 22) + (i)))
+
+/* fills a new table with num_jobs jobs, JIDs 1 to num_jobs */
+static job_list_t* make_table(int num_jobs){
+  job_list_t* j_list = init_job_list();
+  if (j_list == NULL){
+    fprintf(stderr, "ERROR - Job list could not be created.\n");
+    exit(1);
+  }
+  for(int i = 1; i <= num_jobs; i++){
+    if (add_job(j_list, i, FAKE_PID(i), _STATE_RUNNING, "/bin/sleep 1") == -1){
+      fprintf(stderr, "ERROR - Job could not be added.\n");
+      exit(1);
+    }
+  }
+  return j_list;
+}
+
+int main(int argc, char** argv){
+  long iterations = argc > 1 ? atol(argv[1]) : 200000;
+  static const int sizes[] = {10, 100, 1000, 10000};
+  for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++){
+    int size = sizes[s];
+    job_list_t* j_list = make_table(size);
+    volatile long sink = 0;
+
+    /* a job started and reaped on top of the others, as for every command line */
+    int jid = size + 1;
+    double start = bench_now();
+    for(long i = 0; i < iterations; i++){
+      add_job(j_list, jid, FAKE_PID(jid), _STATE_RUNNING, "/bin/true");
+      sink += reap_job_process(j_list, FAKE_PID(jid), 0, NULL);
+      remove_job_jid(j_list, jid);
+    }
+    bench_report("jobs", size, "add_reap_remove_ns", (bench_now() - start) * 1e9
+      / (double) iterations);
+
+    start = bench_now();
+    for(long i = 0; i < iterations; i++){
+      sink += get_job_pid(j_list, (int) (i % size) + 1);
+    }
+    bench_report("jobs", size, "get_job_pid_ns", (bench_now() - start) * 1e9
+      / (double) iterations);
+
+    start = bench_now();
+    for(long i = 0; i < iterations; i++){
+      sink += get_job_jid(j_list, FAKE_PID((int) (i % size) + 1));
+    }
+    bench_report("jobs", size, "get_job_jid_ns", (bench_now() - start) * 1e9
+      / (double) iterations);
+
+    start = bench_now();
+    for(long i = 0; i < iterations; i++){
+      process_state_t state = (i & 1) ? _STATE_RUNNING : _STATE_STOPPED;
+      sink += update_job_pid(j_list, FAKE_PID((int) (i % size) + 1), state);
+    }
+    bench_report("jobs", size, "update_job_pid_ns", (bench_now() - start) * 1e9
+      / (double) iterations);
+
+    /* emptying the whole table, oldest job first as "jobs" lists them */
+    start = bench_now();
+    for(int i = 1; i <= size; i++){
+      sink += remove_job_pid(j_list, FAKE_PID(i));
+    }
+    bench_report("jobs", size, "remove_job_pid_ns", (bench_now() - start) * 1e9
+      / (double) size);
+    cleanup_job_list(j_list);
+  }
+  return 0;
+}
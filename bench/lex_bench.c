@@ -0,0 +1,132 @@
+/*
+ * lex_bench - compares lex_line() with the tokenizing it replaced (count_tokens(), tokenize()
+ * with strtok(), then a strcmp() of every token against "<", ">" and ">>"), on generated command
+ * lines of growing length, printing the time per line of both and the throughput of lex_line()
+ * as JSON lines (see bench.h)
+ *
+ * usage: lex_bench [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../lexer.h"
+#include "bench.h"
+
+/* the old two pass tokenizer, as it was in sh.c */
+static int count_tokens(char* buffer){
+  size_t lead_whitespace = strspn(buffer, "\t ");
+  buffer += lead_whitespace;
+  int num_tok = 0;
+  size_t i1 = 0;
+  while(strcspn((buffer + i1), "\t ") != 0){
+    size_t plus = strcspn((buffer + i1), "\t ");
+    size_t num_delim = strspn((buffer + i1 + plus), "\t ");
+    i1 += (plus + num_delim);
+    num_tok++;
+  }
+  return num_tok;
+}
+
+static void tokenize(char** arr, char* buffer){
+  char* argument = strtok(buffer, "\t ");
+  int i2 = 0;
+  while (argument != NULL){
+    arr[i2] = argument;
+    argument = strtok(NULL, "\t ");
+    i2++;
+  }
+}
+
+/* the old path, returns the number of redirections so the work can't be skipped */
+static int old_lex(char* line){
+  int num_tokens = count_tokens(line);
+  if (!num_tokens){
+    return 0;
+  }
+  char* alltok_arr[num_tokens];
+  tokenize(alltok_arr, line);
+  int redirects = 0;
+  for(int i = 0; i < num_tokens; i++){
+    redirects += !strcmp(alltok_arr[i], "<") || !strcmp(alltok_arr[i], ">")
+      || !strcmp(alltok_arr[i], ">>");
+  }
+  return redirects;
+}
+
+/* the new path, with the arena reset for each line as in sh.c */
+static int new_lex(arena_t* arena, char* line){
+  reset_arena(arena);
+  token_list_t list;
+  init_token_list(&list, arena);
+  if (lex_line(&list, line) == -1){
+    perror("lex_line");
+    exit(1);
+  }
+  int redirects = 0;
+  for(size_t i = 0; i < list.num_tokens; i++){
+    redirects += list.tokens[i].type == TOKEN_INPUT || list.tokens[i].type == TOKEN_OUTPUT
+      || list.tokens[i].type == TOKEN_APPEND;
+  }
+  return redirects;
+}
+
+/* builds a command line of num_words arguments of assorted lengths, with a redirection every
+   16 words, all blank separated so both tokenizers see the same tokens */
+static char* make_line(int num_words){
+  static const char* words[] = {"-l", "--verbose", "file.txt", "/usr/local/share/data/input",
+    "x", "some_longer_argument_value", "42", "a/b/c"};
+  size_t cap = (size_t) num_words * 32 + 16;
+  char* line = (char*) malloc(cap);
+  if (line == NULL){
+    perror("malloc");
+    exit(1);
+  }
+  size_t len = (size_t) sprintf(line, "/bin/cmd");
+  for(int i = 0; i < num_words; i++){
+    const char* word = (i % 16 == 15) ? ">" : words[i % 8];
+    len += (size_t) sprintf(line + len, " %s", word);
+  }
+  return line;
+}
+
+int main(int argc, char** argv){
+  long iterations = argc > 1 ? atol(argv[1]) : 200000;
+  static const int sizes[] = {4, 16, 64, 256, 1024, 4096};
+  arena_t* arena = init_arena(16384);
+  if (arena == NULL){
+    perror("init_arena");
+    exit(1);
+  }
+  for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++){
+    char* line = make_line(sizes[s]);
+    size_t len = strlen(line);
+    char* copy = (char*) malloc(len + 1);
+    if (copy == NULL){
+      perror("malloc");
+      exit(1);
+    }
+    /* fewer iterations for longer lines, so every size takes about as long */
+    long n = iterations * 16 / (sizes[s] + 12);
+    volatile int sink = 0;
+    double start = bench_now();
+    for(long i = 0; i < n; i++){
+      memcpy(copy, line, len + 1);
+      sink += old_lex(copy);
+    }
+    double old_ns = (bench_now() - start) * 1e9 / (double) n;
+    start = bench_now();
+    for(long i = 0; i < n; i++){
+      memcpy(copy, line, len + 1);
+      sink += new_lex(arena, copy);
+    }
+    double new_ns = (bench_now() - start) * 1e9 / (double) n;
+    bench_report("lex", sizes[s], "bytes_per_line", (double) len);
+    bench_report("lex", sizes[s], "old_ns_per_line", old_ns);
+    bench_report("lex", sizes[s], "new_ns_per_line", new_ns);
+    bench_report("lex", sizes[s], "new_mb_per_sec", (double) len * 1e3 / new_ns);
+    free(copy);
+    free(line);
+  }
+  cleanup_arena(arena);
+  return 0;
+}
@@ -0,0 +1,304 @@
+/*
+ * shell_bench - drives the shell (33noprompt by default) with generated scripts, printing JSON
+ * lines (see bench.h):
+ *  - exec: how many trivial commands ("/bin/true") a script runs per second, i.e. the whole REPL
+ *    path of reading, parsing, launching and waiting
+ *  - builtin: the same for "true", which runs in the shell (see builtins.c)
+ *  - exec_zygote: the same as exec, with the commands launched through the zygote (see zygote.h)
+ *  - reap: with 10, 100, 1000 and 10000 background jobs all exiting while the shell waits on a
+ *    foreground job, how long reaping and reporting them takes per job once it returns, measured
+ *    from the shell's own trace (see trace.c)
+ *  - startup: how long "shell -c /bin/true" and "shell -c true" take from spawn to exit, against
+ *    spawning /bin/true directly, i.e. what starting the shell adds before it execs a command
+ *  - server: how long the same request takes as a session of a shell started with --server, from
+ *    connecting to reading the end of its output (see server.h)
+ *
+ * usage: shell_bench [shell] [commands]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "bench.h"
+
+/* creates an unlinked temporary file, returns its descriptor */
+static int temp_file(){
+  char path[] = "/tmp/shell_bench.XXXXXX";
+  int fd = mkstemp(path);
+  if (fd == -1){
+    perror("mkstemp");
+    exit(1);
+  }
+  unlink(path);
+  return fd;
+}
+
+/* opens an unlinked script file for writing the lines of a script */
+static FILE* new_script(){
+  FILE* script = fdopen(temp_file(), "w+");
+  if (script == NULL){
+    perror("fdopen");
+    exit(1);
+  }
+  return script;
+}
+
+/*
+ * run_script() - runs the shell on a script, with its output thrown away
+ *
+ * Parameters:
+ *  - shell: the path of the shell
+ *  - script: the script, rewound before it is run
+ *  - trace_fd: a descriptor for the shell to trace to (as SH33_TRACE_FD), -1 for no trace
+ *
+ * Returns:
+ *	- the wall clock time it took in seconds, exits if the shell could not be run or failed
+ */
+static double run_script(char* shell, FILE* script, int trace_fd){
+  fflush(script);
+  rewind(script);
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, fileno(script), STDIN_FILENO);
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+  posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+  if (trace_fd != -1){
+    posix_spawn_file_actions_adddup2(&actions, trace_fd, 3);
+    setenv("SH33_TRACE_FD", "3", 1);
+  }
+  char* argv[] = {shell, NULL};
+  pid_t pid;
+  double start = bench_now();
+  int err = posix_spawn(&pid, shell, &actions, NULL, argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+  unsetenv("SH33_TRACE_FD");
+  if (err != 0){
+    fprintf(stderr, "ERROR - %s could not be run: %s\n", shell, strerror(err));
+    exit(1);
+  }
+  int status;
+  if (waitpid(pid, &status, 0) == -1){
+    perror("waitpid");
+    exit(1);
+  }
+  double elapsed = bench_now() - start;
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+    fprintf(stderr, "ERROR - %s failed on the script.\n", shell);
+    exit(1);
+  }
+  return elapsed;
+}
+
+/* runs a program with its output thrown away, returns the time it took in seconds, exits if it
+   could not be run or failed */
+static double run_program(char** argv){
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+  posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+  pid_t pid;
+  double start = bench_now();
+  int err = posix_spawn(&pid, argv[0], &actions, NULL, argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+  if (err != 0){
+    fprintf(stderr, "ERROR - %s could not be run: %s\n", argv[0], strerror(err));
+    exit(1);
+  }
+  int status;
+  if (waitpid(pid, &status, 0) == -1){
+    perror("waitpid");
+    exit(1);
+  }
+  double elapsed = bench_now() - start;
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+    fprintf(stderr, "ERROR - %s failed.\n", argv[0]);
+    exit(1);
+  }
+  return elapsed;
+}
+
+/* runs a program over and over, reports the time per run */
+static void bench_startup(const char* metric, char** argv, long runs){
+  double elapsed = 0;
+  for(long i = 0; i < runs; i++){
+    elapsed += run_program(argv);
+  }
+  bench_report("startup", runs, metric, elapsed * 1e6 / (double) runs);
+}
+
+/* connects to a server's socket, returns the descriptor, -1 if it does not accept */
+static int connect_server(const struct sockaddr_un* addr){
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd != -1 && connect(fd, (const struct sockaddr*) addr, sizeof(*addr)) == -1){
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/* sends a server requests ("/bin/true"), each in a session of its own, clients sessions at a
+   time, each request done once its session closes, returns the time it took in seconds, -1 if the
+   server stopped accepting */
+static double run_requests(const struct sockaddr_un* addr, int clients, long requests){
+  static const char request[] = "/bin/true\n";
+  int fds[clients];
+  double start = bench_now();
+  for(long sent = 0; sent < requests; sent += clients){
+    for(int c = 0; c < clients; c++){
+      if ((fds[c] = connect_server(addr)) == -1){
+        perror("connect");
+        return -1;
+      }
+      if (write(fds[c], request, sizeof(request) - 1) == -1 || shutdown(fds[c], SHUT_WR) == -1){
+        perror("write");
+      }
+    }
+    for(int c = 0; c < clients; c++){
+      char buf[256];
+      while (read(fds[c], buf, sizeof(buf)) > 0){
+      }
+      close(fds[c]);
+    }
+  }
+  return bench_now() - start;
+}
+
+/* starts the shell as a server and reports the time per request it serves, with clients sessions
+   at a time */
+static void bench_server(char* shell, int clients, long requests){
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "/tmp/shell_bench.%d.sock", (int) getpid());
+  char* argv[] = {shell, "--server", addr.sun_path, NULL};
+  pid_t pid;
+  int err = posix_spawn(&pid, shell, NULL, NULL, argv, environ);
+  if (err != 0){
+    fprintf(stderr, "ERROR - %s could not be run: %s\n", shell, strerror(err));
+    exit(1);
+  }
+  /* the server is ready once it accepts a connection */
+  int fd;
+  for(int tries = 0; (fd = connect_server(&addr)) == -1; tries++){
+    if (tries == 1000){
+      fprintf(stderr, "ERROR - %s --server did not start.\n", shell);
+      kill(pid, SIGKILL);
+      exit(1);
+    }
+    usleep(1000);
+  }
+  close(fd);
+  double elapsed = run_requests(&addr, clients, requests);
+  kill(pid, SIGTERM);
+  waitpid(pid, NULL, 0);
+  if (elapsed < 0){
+    exit(1);
+  }
+  char metric[64];
+  snprintf(metric, sizeof(metric), "us_per_request_%d_clients", clients);
+  bench_report("server", requests, metric, elapsed * 1e6 / (double) requests);
+}
+
+/* gets the number after "key": in a trace event, 0 if it has none */
+static double event_field(const char* event, const char* key){
+  const char* found = strstr(event, key);
+  return found == NULL ? 0 : atof(found + strlen(key));
+}
+
+/* runs a script of the same command line over and over, returns the time per command in seconds */
+static double bench_exec(char* shell, const char* bench, const char* line, long commands){
+  FILE* script = new_script();
+  for(long i = 0; i < commands; i++){
+    fputs(line, script);
+  }
+  double elapsed = run_script(shell, script, -1);
+  bench_report(bench, commands, "commands_per_sec", (double) commands / elapsed);
+  bench_report(bench, commands, "us_per_command", elapsed * 1e6 / (double) commands);
+  fclose(script);
+  return elapsed / (double) commands;
+}
+
+static void bench_reap(char* shell, int num_jobs, double launch_time){
+  /* the background jobs must outlive the launching of all of them (given the time per command
+     of the exec benchmark, with room to spare), so none is reaped early, and the foreground job
+     must outlive them */
+  double job_time = 0.5 + 2 * launch_time * num_jobs;
+  FILE* script = new_script();
+  for(int i = 0; i < num_jobs; i++){
+    fprintf(script, "sleep %.3f &\n", job_time);
+  }
+  fprintf(script, "sleep %.3f\n", job_time + 0.5);
+  int trace_fd = temp_file();
+  run_script(shell, script, trace_fd);
+  fclose(script);
+
+  /* the foreground wait is the last "wait" span, every exit traced after it was reaped in one go
+     when the shell went back to reading input */
+  FILE* trace = fdopen(trace_fd, "r");
+  if (trace == NULL){
+    perror("fdopen");
+    exit(1);
+  }
+  rewind(trace);
+  char event[1024];
+  double wait_end = 0, last_exit = 0;
+  long reaped = 0;
+  while (fgets(event, sizeof(event), trace) != NULL){
+    if (strstr(event, "\"name\":\"wait\"") != NULL){
+      wait_end = event_field(event, "\"ts\":") + event_field(event, "\"dur\":");
+      reaped = 0;
+    } else if (strstr(event, "\"name\":\"exited\"") != NULL && wait_end > 0){
+      double ts = event_field(event, "\"ts\":");
+      if (ts > wait_end){
+        last_exit = ts;
+        reaped++;
+      }
+    }
+  }
+  fclose(trace);
+  bench_report("reap", num_jobs, "reaped_after_wait", (double) reaped);
+  if (reaped > 0){
+    bench_report("reap", num_jobs, "reap_ns_per_job", (last_exit - wait_end) * 1e3
+      / (double) reaped);
+  }
+}
+
+int main(int argc, char** argv){
+  char* shell = argc > 1 ? argv[1] : "./33noprompt";
+  long commands = argc > 2 ? atol(argv[2]) : 2000;
+  if (access(shell, X_OK) == -1){
+    perror(shell);
+    exit(1);
+  }
+  /* only the reap benchmark traces, to a file of its own, and only exec_zygote has a zygote */
+  unsetenv("SH33_TRACE");
+  unsetenv("SH33_TRACE_FD");
+  unsetenv("SH33_ZYGOTE");
+  double launch_time = bench_exec(shell, "exec", "/bin/true\n", commands);
+  bench_exec(shell, "builtin", "true\n", commands * 10);
+  setenv("SH33_ZYGOTE", "1", 1);
+  bench_exec(shell, "exec_zygote", "/bin/true\n", commands);
+  unsetenv("SH33_ZYGOTE");
+  long runs = commands / 4;
+  char* direct[] = {"/bin/true", NULL};
+  char* exec_line[] = {shell, "-c", "/bin/true", NULL};
+  char* builtin_line[] = {shell, "-c", "true", NULL};
+  bench_startup("direct_us_per_run", direct, runs);
+  bench_startup("exec_us_per_run", exec_line, runs);
+  bench_startup("builtin_us_per_run", builtin_line, runs);
+  static const int clients[] = {1, 16};
+  for(size_t c = 0; c < sizeof(clients) / sizeof(clients[0]); c++){
+    bench_server(shell, clients[c], runs);
+  }
+  static const int sizes[] = {10, 100, 1000, 10000};
+  for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++){
+    bench_reap(shell, sizes[s], launch_time);
+  }
+  return 0;
+}
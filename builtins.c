@@ -0,0 +1,895 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include "builtins.h"
+
+/* size of the buffer copy_data() falls back to, and of each kernel side copy */
+#define COPY_BUFFER_SIZE (1 << 20)
+#define COPY_CHUNK (1 << 30)
+
+/* what copy_data() returns, on an error errno is left set */
+#define COPY_OK 0
+#define COPY_READ_ERROR (-1)
+#define COPY_WRITE_ERROR (-2)
+
+/* flushes standard output, reporting a write error as the program would, returns 0 on success
+   and 1 on failure (the error is cleared, since the shell goes on using stdout) */
+static int flush_output(const char *name){
+  if (fflush(stdout) == EOF || ferror(stdout)){
+    fprintf(stderr, "%s: write error: %s\n", name, strerror(errno));
+    clearerr(stdout);
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * put_escape() - prints the character a backslash escape stands for
+ *
+ * Parameters:
+ *  - s: the escape, just past its backslash
+ *  - octal_zero: 1 if octal escapes are written \0nnn (echo -e and %b), 0 if \nnn (the format
+ *                of printf)
+ *  - stop: an int* set to 1 on \c, which ends all output
+ *
+ * Returns:
+ *	- a pointer just past the escape
+ */
+static const char *put_escape(const char *s, int octal_zero, int *stop){
+  switch (*s){
+    case 'a': putchar('\a'); return s + 1;
+    case 'b': putchar('\b'); return s + 1;
+    case 'f': putchar('\f'); return s + 1;
+    case 'n': putchar('\n'); return s + 1;
+    case 'r': putchar('\r'); return s + 1;
+    case 't': putchar('\t'); return s + 1;
+    case 'v': putchar('\v'); return s + 1;
+    case '\\': putchar('\\'); return s + 1;
+    case 'c': *stop = 1; return s + 1;
+    case '\0': putchar('\\'); return s;
+  }
+  if (*s == 'x' && isxdigit((unsigned char) s[1])){
+    /* \xHH, one or two hex digits */
+    int value = 0;
+    for(int i = 0; i < 2 && isxdigit((unsigned char) s[1]); i++, s++){
+      value = value * 16 + (isdigit((unsigned char) s[1]) ? s[1] - '0'
+        : tolower((unsigned char) s[1]) - 'a' + 10);
+    }
+    putchar(value);
+    return s + 1;
+  }
+  if (octal_zero ? *s == '0' : (*s >= '0' && *s <= '7')){
+    s += octal_zero;
+    int value = 0;
+    for(int i = 0; i < 3 && *s >= '0' && *s <= '7'; i++, s++){
+      value = value * 8 + (*s - '0');
+    }
+    putchar(value & 0xff);
+    return s;
+  }
+  /* not an escape, printed as is */
+  putchar('\\');
+  putchar(*s);
+  return s + 1;
+}
+
+/* prints a string with its backslash escapes (with \0nnn octals), returns 1 if it had a \c */
+static int put_escaped(const char *s, int *stop){
+  while (*s != '\0' && !*stop){
+    if (*s == '\\'){
+      s = put_escape(s + 1, 1, stop);
+    } else {
+      putchar(*s++);
+    }
+  }
+  return *stop;
+}
+
+int builtin_echo(int argc, char **argv){
+  int newline = 1;
+  int escapes = 0;
+  int i = 1;
+  /* options as GNU echo takes them, any mix of n, e and E, anything else is printed */
+  for(; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++){
+    const char *option = argv[i] + 1;
+    if (strspn(option, "neE") != strlen(option)){
+      break;
+    }
+    for(; *option != '\0'; option++){
+      if (*option == 'n'){
+        newline = 0;
+      } else {
+        escapes = (*option == 'e');
+      }
+    }
+  }
+  int stop = 0;
+  for(int first = i; i < argc && !stop; i++){
+    if (i > first){
+      putchar(' ');
+    }
+    if (escapes){
+      put_escaped(argv[i], &stop);
+    } else {
+      fputs(argv[i], stdout);
+    }
+  }
+  if (newline && !stop){
+    putchar('\n');
+  }
+  return flush_output("echo");
+}
+
+int builtin_true(int argc, char **argv){
+  (void) argc;
+  (void) argv;
+  return 0;
+}
+
+int builtin_false(int argc, char **argv){
+  (void) argc;
+  (void) argv;
+  return 1;
+}
+
+/* the arguments of test, with how far they have been parsed, error is 1 on a syntax error and 2
+   if an error was already printed */
+typedef struct test_state {
+  char **argv;
+  int argc;
+  int pos;
+  int error;
+} test_state_t;
+
+static int test_or(test_state_t *t);
+
+static int is_unary(const char *op){
+  return op[0] == '-' && op[1] != '\0' && op[2] == '\0' && strchr("bcdefghkLnprsStuwxz", op[1]);
+}
+
+static int is_binary(const char *op){
+  static const char *ops[] = {"=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le", "-gt",
+    "-ge", "-nt", "-ot", "-ef"};
+  for(size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++){
+    if (!strcmp(op, ops[i])){
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static long long test_integer(test_state_t *t, const char *s){
+  char *end;
+  errno = 0;
+  long long value = strtoll(s, &end, 10);
+  if (end == s || *end != '\0' || errno == ERANGE){
+    if (!t->error){
+      fprintf(stderr, "test: %s: integer expression expected\n", s);
+      t->error = 2;
+    }
+  }
+  return value;
+}
+
+static int test_unary(test_state_t *t, char op, const char *arg){
+  struct stat st;
+  switch (op){
+    case 'n': return *arg != '\0';
+    case 'z': return *arg == '\0';
+    case 't': return isatty((int) test_integer(t, arg));
+    case 'r': return access(arg, R_OK) == 0;
+    case 'w': return access(arg, W_OK) == 0;
+    case 'x': return access(arg, X_OK) == 0;
+    case 'h':
+    case 'L': return lstat(arg, &st) == 0 && S_ISLNK(st.st_mode);
+  }
+  if (stat(arg, &st) == -1){
+    return 0;
+  }
+  switch (op){
+    case 'e': return 1;
+    case 'f': return S_ISREG(st.st_mode);
+    case 'd': return S_ISDIR(st.st_mode);
+    case 'b': return S_ISBLK(st.st_mode);
+    case 'c': return S_ISCHR(st.st_mode);
+    case 'p': return S_ISFIFO(st.st_mode);
+    case 'S': return S_ISSOCK(st.st_mode);
+    case 's': return st.st_size > 0;
+    case 'g': return (st.st_mode & S_ISGID) != 0;
+    case 'u': return (st.st_mode & S_ISUID) != 0;
+    case 'k': return (st.st_mode & S_ISVTX) != 0;
+  }
+  return 0;
+}
+
+/* compares the modification times of two files, a missing file being older than any other */
+static int test_newer(const char *left, const char *right){
+  struct stat l, r;
+  if (stat(left, &l) == -1){
+    return 0;
+  }
+  if (stat(right, &r) == -1){
+    return 1;
+  }
+  return l.st_mtim.tv_sec > r.st_mtim.tv_sec
+    || (l.st_mtim.tv_sec == r.st_mtim.tv_sec && l.st_mtim.tv_nsec > r.st_mtim.tv_nsec);
+}
+
+static int test_binary(test_state_t *t, const char *left, const char *op, const char *right){
+  if (!strcmp(op, "=") || !strcmp(op, "==")){
+    return !strcmp(left, right);
+  }
+  if (!strcmp(op, "!=")){
+    return strcmp(left, right) != 0;
+  }
+  if (!strcmp(op, "<")){
+    return strcmp(left, right) < 0;
+  }
+  if (!strcmp(op, ">")){
+    return strcmp(left, right) > 0;
+  }
+  if (!strcmp(op, "-nt")){
+    return test_newer(left, right);
+  }
+  if (!strcmp(op, "-ot")){
+    return test_newer(right, left);
+  }
+  if (!strcmp(op, "-ef")){
+    struct stat l, r;
+    return stat(left, &l) == 0 && stat(right, &r) == 0 && l.st_dev == r.st_dev
+      && l.st_ino == r.st_ino;
+  }
+  long long l = test_integer(t, left);
+  long long r = test_integer(t, right);
+  switch (op[1] * 256 + op[2]){
+    case 'e' * 256 + 'q': return l == r;
+    case 'n' * 256 + 'e': return l != r;
+    case 'l' * 256 + 't': return l < r;
+    case 'l' * 256 + 'e': return l <= r;
+    case 'g' * 256 + 't': return l > r;
+    default: return l >= r;
+  }
+}
+
+/* a binary expression, a unary one, a parenthesized one, or a lone string (true if not empty) */
+static int test_primary(test_state_t *t){
+  int remaining = t->argc - t->pos;
+  if (remaining <= 0){
+    t->error = t->error ? t->error : 1;
+    return 0;
+  }
+  char *arg = t->argv[t->pos];
+  if (remaining >= 3 && is_binary(t->argv[t->pos + 1])){
+    t->pos += 3;
+    return test_binary(t, arg, t->argv[t->pos - 2], t->argv[t->pos - 1]);
+  }
+  if (remaining >= 2 && !strcmp(arg, "(")){
+    t->pos++;
+    int value = test_or(t);
+    if (t->pos >= t->argc || strcmp(t->argv[t->pos], ")")){
+      t->error = t->error ? t->error : 1;
+      return 0;
+    }
+    t->pos++;
+    return value;
+  }
+  if (remaining >= 2 && is_unary(arg)){
+    t->pos += 2;
+    return test_unary(t, arg[1], t->argv[t->pos - 1]);
+  }
+  t->pos++;
+  return *arg != '\0';
+}
+
+/* "!" negates, unless the three arguments left make a binary expression ("! = x") */
+static int test_not(test_state_t *t){
+  int remaining = t->argc - t->pos;
+  if (remaining >= 2 && !strcmp(t->argv[t->pos], "!")
+      && !(remaining == 3 && is_binary(t->argv[t->pos + 1]))){
+    t->pos++;
+    return !test_not(t);
+  }
+  return test_primary(t);
+}
+
+/* -a binds tighter than -o, both sides are always evaluated (nothing has side effects) */
+static int test_and(test_state_t *t){
+  int value = test_not(t);
+  while (t->pos < t->argc && !strcmp(t->argv[t->pos], "-a")){
+    t->pos++;
+    value = test_not(t) & value;
+  }
+  return value;
+}
+
+static int test_or(test_state_t *t){
+  int value = test_and(t);
+  while (t->pos < t->argc && !strcmp(t->argv[t->pos], "-o")){
+    t->pos++;
+    value = test_and(t) | value;
+  }
+  return value;
+}
+
+int builtin_test(int argc, char **argv){
+  if (!strcmp(argv[0], "[")){
+    if (strcmp(argv[argc - 1], "]")){
+      fprintf(stderr, "[: missing ']'\n");
+      return 2;
+    }
+    argc--;
+  }
+  if (argc == 1){
+    return 1;
+  }
+  test_state_t t = {argv, argc, 1, 0};
+  int value = test_or(&t);
+  if (!t.error && t.pos != t.argc){
+    t.error = 1;
+  }
+  if (t.error == 1){
+    fprintf(stderr, "%s: syntax error\n", argv[0]);
+  }
+  return t.error ? 2 : !value;
+}
+
+/* the arguments of printf still to be used, and its exit status so far */
+typedef struct printf_args {
+  char **argv;
+  int num;
+  int next;
+  int status;
+} printf_args_t;
+
+/* gets the next argument, NULL once they have run out */
+static const char *next_arg(printf_args_t *a){
+  return a->next < a->num ? a->argv[a->next++] : NULL;
+}
+
+/* checks that an argument was a whole number, and reports it if not */
+static void check_number(printf_args_t *a, const char *arg, const char *end){
+  if (end == arg || *end != '\0' || errno == ERANGE){
+    fprintf(stderr, "printf: %s: invalid number\n", arg);
+    a->status = 1;
+  }
+}
+
+/* the next argument as a signed or unsigned integer, or as the code of the character after a
+   leading quote ('A is 65), 0 if there is none */
+static long long arg_integer(printf_args_t *a, int is_unsigned){
+  const char *arg = next_arg(a);
+  if (arg == NULL){
+    return 0;
+  }
+  if (*arg == '\'' || *arg == '"'){
+    return (unsigned char) arg[1];
+  }
+  char *end;
+  errno = 0;
+  long long value = is_unsigned ? (long long) strtoull(arg, &end, 0) : strtoll(arg, &end, 0);
+  check_number(a, arg, end);
+  return value;
+}
+
+static double arg_double(printf_args_t *a){
+  const char *arg = next_arg(a);
+  if (arg == NULL){
+    return 0;
+  }
+  char *end;
+  errno = 0;
+  double value = strtod(arg, &end);
+  check_number(a, arg, end);
+  return value;
+}
+
+/* copies the digits of a width or precision into spec, or the next argument for a "*" */
+static const char *copy_width(const char *f, char *spec, size_t *len, printf_args_t *a){
+  if (*f == '*'){
+    *len += (size_t) snprintf(spec + *len, 12, "%d", (int) arg_integer(a, 0));
+    return f + 1;
+  }
+  for(int i = 0; i < 9 && *f >= '0' && *f <= '9'; i++){
+    spec[(*len)++] = *f++;
+  }
+  return f;
+}
+
+/*
+ * put_conversion() - prints one conversion of a printf format, passing the flags, width and
+ *                    precision on to the C printf()
+ *
+ * Parameters:
+ *  - f: the conversion, at its '%'
+ *  - a: the arguments
+ *  - stop: an int* set to 1 if output must end (\c in a %b argument, or a bad conversion)
+ *
+ * Returns:
+ *	- a pointer just past the conversion
+ */
+static const char *put_conversion(const char *f, printf_args_t *a, int *stop){
+  /* at most "%" + 5 flags + 2 * 11 digits + "." + "ll" + the conversion + NUL */
+  char spec[40];
+  size_t len = 0;
+  const char *begin = f;
+  spec[len++] = *f++;
+  if (*f == '%'){
+    putchar('%');
+    return f + 1;
+  }
+  for(int i = 0; i < 5 && *f != '\0' && strchr("-+ #0", *f); i++){
+    spec[len++] = *f++;
+  }
+  f = copy_width(f, spec, &len, a);
+  if (*f == '.'){
+    spec[len++] = *f++;
+    f = copy_width(f, spec, &len, a);
+  }
+  /* C length modifiers mean nothing here, every integer is a long long */
+  while (*f != '\0' && strchr("hlLqjzt", *f)){
+    f++;
+  }
+  char conversion = *f;
+  if (conversion == '\0' || !strchr("diouxXfFeEgGaAcsb", conversion)){
+    f += conversion != '\0';
+    fprintf(stderr, "printf: %.*s: invalid conversion specification\n", (int) (f - begin), begin);
+    a->status = 1;
+    *stop = 1;
+    return f;
+  }
+  f++;
+  if (strchr("diouxX", conversion)){
+    spec[len++] = 'l';
+    spec[len++] = 'l';
+  }
+  spec[len++] = conversion == 'b' ? 's' : conversion;
+  spec[len] = '\0';
+  switch (conversion){
+    case 'd':
+    case 'i':
+      printf(spec, arg_integer(a, 0));
+      break;
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+      printf(spec, (unsigned long long) arg_integer(a, 1));
+      break;
+    case 'c': {
+      const char *arg = next_arg(a);
+      printf(spec, arg != NULL ? arg[0] : '\0');
+      break;
+    }
+    case 's': {
+      const char *arg = next_arg(a);
+      printf(spec, arg != NULL ? arg : "");
+      break;
+    }
+    case 'b': {
+      const char *arg = next_arg(a);
+      put_escaped(arg != NULL ? arg : "", stop);
+      break;
+    }
+    default:
+      printf(spec, arg_double(a));
+  }
+  return f;
+}
+
+int builtin_printf(int argc, char **argv){
+  if (argc > 1 && !strcmp(argv[1], "--")){
+    argc--;
+    argv++;
+  }
+  if (argc < 2){
+    fprintf(stderr, "printf: missing operand\n");
+    return 1;
+  }
+  printf_args_t a = {argv + 2, argc - 2, 0, 0};
+  int stop = 0;
+  /* the format is used again for the arguments left, as long as it takes any */
+  do {
+    int first = a.next;
+    for(const char *f = argv[1]; *f != '\0' && !stop;){
+      if (*f == '\\'){
+        f = put_escape(f + 1, 0, &stop);
+      } else if (*f == '%'){
+        f = put_conversion(f, &a, &stop);
+      } else {
+        putchar(*f++);
+      }
+    }
+    if (a.next == first){
+      break;
+    }
+  } while (a.next < a.num && !stop);
+  return flush_output("printf") | a.status;
+}
+
+/* writes all of a buffer, returns 0 on success, -1 with errno set on failure */
+static int write_all(int fd, const char *buffer, size_t len){
+  while (len > 0){
+    ssize_t written = write(fd, buffer, len);
+    if (written == -1){
+      if (errno == EINTR){
+        continue;
+      }
+      return -1;
+    }
+    buffer += written;
+    len -= (size_t) written;
+  }
+  return 0;
+}
+
+/* the errors that mean a kernel side copy can't be used for these two files (e.g. different
+   file systems for copy_file_range(), an O_APPEND or a tty output for both), rather than that
+   reading or writing failed */
+static int copy_unsupported(int err){
+  return err == EXDEV || err == EINVAL || err == ENOSYS || err == EOPNOTSUPP || err == EBADF;
+}
+
+/* copies until the end of the input with copy_file_range() (method 0) or sendfile() (1), using
+   and moving both files' offsets, returns 0 at the end of the input, -1 with errno set else */
+static int kernel_copy(int method, int in_fd, int out_fd){
+  ssize_t n;
+  do {
+    if (method == 0){
+      n = copy_file_range(in_fd, NULL, out_fd, NULL, COPY_CHUNK, 0);
+    } else {
+      n = sendfile(out_fd, in_fd, NULL, COPY_CHUNK);
+    }
+  } while (n > 0 || (n == -1 && errno == EINTR));
+  return (int) n;
+}
+
+/*
+ * copy_data() - copies the rest of one file into another, with no data passing through the
+ *               shell when the kernel can do it: copy_file_range() (which may even share the
+ *               blocks, or copy on the server for NFS), then sendfile(), then a read() and
+ *               write() loop through a large buffer, each one picking up where the last stopped
+ *
+ * Parameters:
+ *  - in_fd: the file to read, from its offset on
+ *  - out_fd: the file to write, at its offset
+ *
+ * Returns:
+ *	- COPY_OK, or COPY_READ_ERROR or COPY_WRITE_ERROR with errno set
+ */
+static int copy_data(int in_fd, int out_fd){
+  static char buffer[COPY_BUFFER_SIZE];
+  struct stat st;
+  /* both kernel side copies need a regular file to read from, and one with a size, as the files
+     of /proc and /sys say they are empty and would come out empty */
+  if (fstat(in_fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0){
+    for(int method = 0; method < 2; method++){
+      if (kernel_copy(method, in_fd, out_fd) == 0){
+        break;
+      }
+      if (!copy_unsupported(errno)){
+        return COPY_WRITE_ERROR;
+      }
+    }
+  }
+  /* whatever is left, which is everything if neither could be used, and usually nothing */
+  while (1){
+    ssize_t n = read(in_fd, buffer, sizeof(buffer));
+    if (n == 0){
+      return COPY_OK;
+    }
+    if (n == -1){
+      if (errno == EINTR){
+        continue;
+      }
+      return COPY_READ_ERROR;
+    }
+    if (write_all(out_fd, buffer, (size_t) n) == -1){
+      return COPY_WRITE_ERROR;
+    }
+  }
+}
+
+int copy_fd(int in_fd, int out_fd){
+  return copy_data(in_fd, out_fd) == COPY_OK ? 0 : -1;
+}
+
+/* copies a file to standard output, returns 0 on success, 1 if it could not be read, and -1 if
+   standard output could not be written (both reported) */
+static int cat_fd(int fd, const char *name){
+  int result = copy_data(fd, STDOUT_FILENO);
+  if (result == COPY_READ_ERROR){
+    fprintf(stderr, "cat: %s: %s\n", name, strerror(errno));
+    return 1;
+  }
+  if (result == COPY_WRITE_ERROR){
+    fprintf(stderr, "cat: write error: %s\n", strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+/* what the shell read of standard input past the command, which cat reads first (see
+   set_input_ahead()) */
+static const char *input_ahead = NULL;
+static size_t input_ahead_len = 0;
+
+void set_input_ahead(const char *data, size_t len){
+  input_ahead = data;
+  input_ahead_len = len;
+}
+
+size_t take_input_ahead(void){
+  size_t len = input_ahead_len;
+  input_ahead = NULL;
+  input_ahead_len = 0;
+  return len;
+}
+
+/* copies standard input to standard output as cat_fd() does, after what the shell read ahead of
+   it, returns as cat_fd() does */
+static int cat_input(void){
+  if (input_ahead_len > 0){
+    if (write_all(STDOUT_FILENO, input_ahead, input_ahead_len) == -1){
+      fprintf(stderr, "cat: write error: %s\n", strerror(errno));
+      return -1;
+    }
+    input_ahead_len = 0;
+  }
+  return cat_fd(STDIN_FILENO, "-");
+}
+
+int builtin_cat_reads_input(int argc, char **argv){
+  int options = 1;
+  int num_files = 0;
+  for(int i = 1; i < argc; i++){
+    if (options && !strcmp(argv[i], "--")){
+      options = 0;
+    } else if (!options || argv[i][0] != '-' || argv[i][1] == '\0'){
+      if (!strcmp(argv[i], "-")){
+        return 1;
+      }
+      num_files++;
+    }
+  }
+  return num_files == 0;
+}
+
+int builtin_cat(int argc, char **argv){
+  /* only -u (which unbuffered output makes a no-op) is implemented, checked before any output */
+  int options = 1;
+  int num_files = 0;
+  for(int i = 1; i < argc; i++){
+    if (options && !strcmp(argv[i], "--")){
+      options = 0;
+    } else if (options && argv[i][0] == '-' && argv[i][1] != '\0'){
+      if (strcmp(argv[i], "-u")){
+        return BUILTIN_UNSUPPORTED;
+      }
+    } else {
+      num_files++;
+    }
+  }
+  fflush(stdout);
+  if (num_files == 0){
+    return cat_input() != 0;
+  }
+  int status = 0;
+  options = 1;
+  for(int i = 1; i < argc; i++){
+    if (options && !strcmp(argv[i], "--")){
+      options = 0;
+      continue;
+    }
+    if (options && argv[i][0] == '-' && argv[i][1] != '\0'){
+      continue;
+    }
+    int result;
+    if (!strcmp(argv[i], "-")){
+      result = cat_input();
+    } else {
+      int fd = open(argv[i], O_RDONLY | O_CLOEXEC);
+      if (fd == -1){
+        fprintf(stderr, "cat: %s: %s\n", argv[i], strerror(errno));
+        status = 1;
+        continue;
+      }
+      result = cat_fd(fd, argv[i]);
+      close(fd);
+    }
+    if (result == -1){
+      return 1;
+    }
+    status |= result;
+  }
+  return status;
+}
+
+/*
+ * copy_file() - copies a regular file's data to another file, creating or truncating it
+ *
+ * Parameters:
+ *  - name: the name of the builtin, for the messages
+ *  - src: the file to copy
+ *  - dst: the file to copy it to
+ *  - preserve: 1 to give the copy the mode, owner and times of the original (for mv), 0 to
+ *              create it with the original's permissions less the umask (as cp does)
+ *
+ * Returns:
+ *	- 0 on success, 1 on failure (which has been printed)
+ */
+static int copy_file(const char *name, const char *src, const char *dst, int preserve){
+  int in_fd = open(src, O_RDONLY | O_CLOEXEC);
+  if (in_fd == -1){
+    fprintf(stderr, "%s: cannot open '%s' for reading: %s\n", name, src, strerror(errno));
+    return 1;
+  }
+  struct stat st, dst_st;
+  if (fstat(in_fd, &st) == -1){
+    fprintf(stderr, "%s: cannot stat '%s': %s\n", name, src, strerror(errno));
+    close(in_fd);
+    return 1;
+  }
+  if (S_ISDIR(st.st_mode)){
+    fprintf(stderr, "%s: -r not specified; omitting directory '%s'\n", name, src);
+    close(in_fd);
+    return 1;
+  }
+  if (stat(dst, &dst_st) == 0 && dst_st.st_dev == st.st_dev && dst_st.st_ino == st.st_ino){
+    fprintf(stderr, "%s: '%s' and '%s' are the same file\n", name, src, dst);
+    close(in_fd);
+    return 1;
+  }
+  int out_fd = open(dst, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 0777);
+  if (out_fd == -1){
+    fprintf(stderr, "%s: cannot create regular file '%s': %s\n", name, dst, strerror(errno));
+    close(in_fd);
+    return 1;
+  }
+  int result = copy_data(in_fd, out_fd);
+  if (result != COPY_OK){
+    fprintf(stderr, "%s: error %s '%s': %s\n", name,
+      result == COPY_READ_ERROR ? "reading" : "writing",
+      result == COPY_READ_ERROR ? src : dst, strerror(errno));
+    /* a move leaves no half copy behind, the original is still there */
+    if (preserve){
+      unlink(dst);
+    }
+  } else if (preserve){
+    /* the owner can only be kept by root, which is not an error, as with mv */
+    struct timespec times[2] = {st.st_atim, st.st_mtim};
+    if (fchown(out_fd, st.st_uid, st.st_gid) == -1){
+      st.st_mode &= ~(mode_t) (S_ISUID | S_ISGID);
+    }
+    fchmod(out_fd, st.st_mode & 07777);
+    futimens(out_fd, times);
+  }
+  if (close(out_fd) == -1 && result == COPY_OK){
+    fprintf(stderr, "%s: error writing '%s': %s\n", name, dst, strerror(errno));
+    result = COPY_WRITE_ERROR;
+  }
+  close(in_fd);
+  return result != COPY_OK;
+}
+
+/* renames a file, copying it and removing the original if it is on another file system,
+   returns 0 on success, 1 on failure (which has been printed) */
+static int move_file(const char *name, const char *src, const char *dst){
+  if (rename(src, dst) == 0){
+    return 0;
+  }
+  if (errno != EXDEV){
+    fprintf(stderr, "%s: cannot move '%s' to '%s': %s\n", name, src, dst, strerror(errno));
+    return 1;
+  }
+  if (copy_file(name, src, dst, 1) != 0){
+    return 1;
+  }
+  if (unlink(src) == -1){
+    fprintf(stderr, "%s: cannot remove '%s': %s\n", name, src, strerror(errno));
+    return 1;
+  }
+  return 0;
+}
+
+/* joins a directory and the last component of path into buffer (of PATH_MAX bytes), returns
+   buffer, or NULL if the result is too long */
+static char *path_in_dir(const char *dir, const char *path, char *buffer){
+  size_t len = strlen(path);
+  while (len > 1 && path[len - 1] == '/'){
+    len--;
+  }
+  size_t base = len;
+  while (base > 0 && path[base - 1] != '/'){
+    base--;
+  }
+  int written = snprintf(buffer, PATH_MAX, "%s/%.*s", dir, (int) (len - base), path + base);
+  return written < 0 || written >= PATH_MAX ? NULL : buffer;
+}
+
+/* checks that mv can move every source, i.e. that the ones it can't copy (anything but a regular
+   file) are on the same file system as the target's directory, so rename() will do */
+static int can_move(char **sources, int num_sources, const char *target, int to_dir){
+  char dir[PATH_MAX];
+  if (to_dir){
+    snprintf(dir, sizeof(dir), "%s", target);
+  } else {
+    const char *slash = strrchr(target, '/');
+    snprintf(dir, sizeof(dir), "%.*s", slash == NULL ? 1 : (int) (slash - target + 1),
+      slash == NULL ? "." : target);
+  }
+  struct stat dir_st, st;
+  if (stat(dir, &dir_st) == -1){
+    return 1;
+  }
+  for(int i = 0; i < num_sources; i++){
+    if (lstat(sources[i], &st) == 0 && !S_ISREG(st.st_mode) && st.st_dev != dir_st.st_dev){
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* cp and mv, which take no options here but "--", and a file and its new name or any number of
+   files and a directory */
+static int copy_or_move(int argc, char **argv, int move){
+  const char *name = argv[0];
+  int first = 1;
+  if (argc > 1 && !strcmp(argv[1], "--")){
+    first = 2;
+  } else {
+    for(int i = 1; i < argc; i++){
+      if (argv[i][0] == '-' && argv[i][1] != '\0'){
+        return BUILTIN_UNSUPPORTED;
+      }
+    }
+  }
+  char **operands = argv + first;
+  int num_operands = argc - first;
+  if (num_operands < 2){
+    if (num_operands == 0){
+      fprintf(stderr, "%s: missing file operand\n", name);
+    } else {
+      fprintf(stderr, "%s: missing destination file operand after '%s'\n", name, operands[0]);
+    }
+    return 1;
+  }
+  const char *target = operands[num_operands - 1];
+  struct stat target_st;
+  int to_dir = stat(target, &target_st) == 0 && S_ISDIR(target_st.st_mode);
+  if (num_operands > 2 && !to_dir){
+    fprintf(stderr, "%s: target '%s' is not a directory\n", name, target);
+    return 1;
+  }
+  if (move && !can_move(operands, num_operands - 1, target, to_dir)){
+    return BUILTIN_UNSUPPORTED;
+  }
+  int status = 0;
+  char path[PATH_MAX];
+  for(int i = 0; i < num_operands - 1; i++){
+    const char *dst = to_dir ? path_in_dir(target, operands[i], path) : target;
+    if (dst == NULL){
+      fprintf(stderr, "%s: '%s': %s\n", name, operands[i], strerror(ENAMETOOLONG));
+      status = 1;
+    } else if (move){
+      status |= move_file(name, operands[i], dst);
+    } else {
+      status |= copy_file(name, operands[i], dst, 0);
+    }
+  }
+  return status;
+}
+
+int builtin_cp(int argc, char **argv){
+  return copy_or_move(argc, argv, 0);
+}
+
+int builtin_mv(int argc, char **argv){
+  return copy_or_move(argc, argv, 1);
+}
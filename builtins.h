@@ -0,0 +1,51 @@
+#ifndef BUILTINS_H_
+#define BUILTINS_H_
+
+#include <stddef.h>
+
+/*
+ * In-process versions of utilities that scripts call all the time, so running them costs no
+ * process creation. Each takes its arguments like main() (argv[0] being the name it was called
+ * by), writes to the shell's own standard output and error, and returns the exit status the
+ * program would have, or BUILTIN_UNSUPPORTED if it was given an option it doesn't implement, in
+ * which case nothing has been read or written and the program should be run instead.
+ */
+#define BUILTIN_UNSUPPORTED (-1)
+
+/* echo [-neE] [string ...] */
+int builtin_echo(int argc, char **argv);
+
+/* true, always 0 */
+int builtin_true(int argc, char **argv);
+
+/* false, always 1 */
+int builtin_false(int argc, char **argv);
+
+/* test expression, or [ expression ], 0 if it is true, 1 if false, 2 on a syntax error */
+int builtin_test(int argc, char **argv);
+
+/* printf format [argument ...], the format being reused until the arguments run out */
+int builtin_printf(int argc, char **argv);
+
+/* cat [-u] [file ...], "-" (or no file) being standard input, copying inside the kernel where
+   it can (see copy_data()) */
+int builtin_cat(int argc, char **argv);
+/* 1 if cat would read standard input given these arguments, 0 else */
+int builtin_cat_reads_input(int argc, char **argv);
+/* has cat read the len bytes at data before standard input, what the shell read of it past the
+   command, until take_input_ahead() */
+void set_input_ahead(const char *data, size_t len);
+/* stops cat reading what set_input_ahead() gave, returns how many bytes of it were not read */
+size_t take_input_ahead(void);
+
+/* copies the rest of in_fd to out_fd as cat does, inside the kernel where it can, returns 0 on
+   success, -1 on failure with errno set */
+int copy_fd(int in_fd, int out_fd);
+
+/* cp file target, or cp file ... directory, copying inside the kernel where it can */
+int builtin_cp(int argc, char **argv);
+
+/* mv file target, or mv file ... directory, copying and removing across file systems */
+int builtin_mv(int argc, char **argv);
+
+#endif  // BUILTINS_H_
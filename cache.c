@@ -0,0 +1,514 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "cache.h"
+#include "builtins.h"
+
+/* the limit of a store when SH33_CACHE_SIZE doesn't give one */
+#define CACHE_DEFAULT_LIMIT ((off_t) 256 << 20)
+/* eviction goes this far under the limit (in percent), so it isn't needed again right away */
+#define CACHE_EVICT_TO 90
+/* stands in front of what a key is made of, changed whenever that changes */
+#define CACHE_KEY_VERSION "33sh cache 1"
+
+/* SHA-256 as FIPS 180-4 has it, fed a piece at a time */
+typedef struct sha256 {
+  uint32_t state[8];
+  uint64_t length;
+  unsigned char block[64];
+  size_t used;
+} sha256_t;
+
+static const uint32_t sha256_k[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(uint32_t *state, const unsigned char *block){
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++){
+    w[i] = (uint32_t) block[4 * i] << 24 | (uint32_t) block[4 * i + 1] << 16
+      | (uint32_t) block[4 * i + 2] << 8 | (uint32_t) block[4 * i + 3];
+  }
+  for (int i = 16; i < 64; i++){
+    uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+  uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+  for (int i = 0; i < 64; i++){
+    uint32_t t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g))
+      + sha256_k[i] + w[i];
+    uint32_t t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
+
+static void sha256_init(sha256_t *ctx){
+  static const uint32_t initial[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  };
+  memcpy(ctx->state, initial, sizeof(initial));
+  ctx->length = 0;
+  ctx->used = 0;
+}
+
+static void sha256_update(sha256_t *ctx, const void *data, size_t len){
+  const unsigned char *bytes = (const unsigned char *) data;
+  ctx->length += len;
+  while (len > 0){
+    size_t take = sizeof(ctx->block) - ctx->used < len ? sizeof(ctx->block) - ctx->used : len;
+    memcpy(ctx->block + ctx->used, bytes, take);
+    ctx->used += take;
+    bytes += take;
+    len -= take;
+    if (ctx->used == sizeof(ctx->block)){
+      sha256_block(ctx->state, ctx->block);
+      ctx->used = 0;
+    }
+  }
+}
+
+/* finishes the hash, as 64 hex digits and a '\0' */
+static void sha256_final(sha256_t *ctx, char *hex){
+  uint64_t bits = ctx->length * 8;
+  unsigned char pad = 0x80;
+  sha256_update(ctx, &pad, 1);
+  pad = 0;
+  while (ctx->used != 56){
+    sha256_update(ctx, &pad, 1);
+  }
+  unsigned char length[8];
+  for (int i = 0; i < 8; i++){
+    length[i] = (unsigned char) (bits >> (56 - 8 * i));
+  }
+  sha256_update(ctx, length, sizeof(length));
+  for (int i = 0; i < 8; i++){
+    snprintf(hex + 8 * i, 9, "%08x", ctx->state[i]);
+  }
+}
+
+/* one stored output, for eviction */
+typedef struct cache_object {
+  char name[65];
+  struct timespec used;
+  off_t size;
+} cache_object_t;
+
+/* the store, found on first use, fd being its directory (-1 if there is none) and size the total
+   size of its objects as last counted plus what was stored since (-1 until counted) */
+static struct {
+  int initialized;
+  int fd;
+  char path[PATH_MAX];
+  char temp[PATH_MAX + 64];
+  unsigned long next_temp;
+  off_t limit;
+  off_t size;
+  long hits;
+  long misses;
+  long evicted;
+} cache = {0, -1, "", "", 0, CACHE_DEFAULT_LIMIT, -1, 0, 0, 0};
+
+int parse_cache_size(const char *text, off_t *size){
+  char *end;
+  errno = 0;
+  long long value = strtoll(text, &end, 10);
+  if (end == text || value < 0 || errno == ERANGE){
+    return -1;
+  }
+  const char *units = "KMG";
+  const char *unit = *end != '\0' ? strchr(units, *end) : NULL;
+  if (unit != NULL){
+    /* a size too big to count in bytes is not one */
+    int shift = 10 * (int) (unit - units + 1);
+    if (value > LLONG_MAX >> shift){
+      return -1;
+    }
+    value <<= shift;
+    end++;
+  }
+  if (*end != '\0'){
+    return -1;
+  }
+  *size = (off_t) value;
+  return 0;
+}
+
+/* makes a directory and any of its parents that are missing, returns 0 on success, -1 else */
+static int make_dirs(char *path){
+  for (char *slash = strchr(path + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/')){
+    *slash = '\0';
+    int made = mkdir(path, 0700) == 0 || errno == EEXIST;
+    *slash = '/';
+    if (!made){
+      return -1;
+    }
+  }
+  return mkdir(path, 0700) == 0 || errno == EEXIST ? 0 : -1;
+}
+
+/* finds (and makes) the store, returns 0 if there is one, -1 else */
+static int init_cache(){
+  if (cache.initialized){
+    return cache.fd != -1 ? 0 : -1;
+  }
+  cache.initialized = 1;
+  const char *size = getenv("SH33_CACHE_SIZE");
+  if (size != NULL && parse_cache_size(size, &cache.limit) == -1){
+    fprintf(stderr, "cache: SH33_CACHE_SIZE: not a size\n");
+  }
+  const char *dir = getenv("SH33_CACHE_DIR");
+  const char *home;
+  if (dir != NULL && *dir != '\0'){
+    snprintf(cache.path, sizeof(cache.path), "%s", dir);
+  } else if ((home = getenv("XDG_CACHE_HOME")) != NULL && *home == '/'){
+    snprintf(cache.path, sizeof(cache.path), "%s/33sh", home);
+  } else if ((home = getenv("HOME")) != NULL && *home == '/'){
+    snprintf(cache.path, sizeof(cache.path), "%s/.cache/33sh", home);
+  } else {
+    return -1;
+  }
+  size_t len = strlen(cache.path);
+  static const char *subdirs[] = {"objects", "keys", "tmp"};
+  for (size_t i = 0; i < sizeof(subdirs) / sizeof(subdirs[0]); i++){
+    snprintf(cache.path + len, sizeof(cache.path) - len, "/%s", subdirs[i]);
+    if (make_dirs(cache.path) == -1){
+      cache.path[len] = '\0';
+      perror(cache.path);
+      return -1;
+    }
+  }
+  cache.path[len] = '\0';
+  cache.fd = open(cache.path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  return cache.fd != -1 ? 0 : -1;
+}
+
+/* adds one part of a key, with its length in front so no two keys run together alike */
+static void add_key_part(sha256_t *ctx, const void *data, size_t len){
+  uint64_t length = len;
+  sha256_update(ctx, &length, sizeof(length));
+  sha256_update(ctx, data, len);
+}
+
+/* adds what tells a file apart from any other, or from itself once changed */
+static void add_key_file(sha256_t *ctx, const struct stat *st){
+  char identity[160];
+  int len = snprintf(identity, sizeof(identity), "%lu %lu %o %lld %ld.%09ld %ld.%09ld",
+    (unsigned long) st->st_dev, (unsigned long) st->st_ino, (unsigned) st->st_mode,
+    (long long) st->st_size, (long) st->st_mtim.tv_sec, st->st_mtim.tv_nsec,
+    (long) st->st_ctim.tv_sec, st->st_ctim.tv_nsec);
+  add_key_part(ctx, identity, (size_t) len);
+}
+
+int make_cache_key(cache_key_t *key, char **argv, const char *path, int in_fd){
+  sha256_t ctx;
+  sha256_init(&ctx);
+  add_key_part(&ctx, CACHE_KEY_VERSION, strlen(CACHE_KEY_VERSION));
+  int argc = 0;
+  for (; argv[argc] != NULL; argc++){
+    add_key_part(&ctx, argv[argc], strlen(argv[argc]));
+  }
+  add_key_part(&ctx, &argc, sizeof(argc));
+  struct stat st;
+  if (stat(path, &st) == -1){
+    return -1;
+  }
+  add_key_file(&ctx, &st);
+  char cwd[PATH_MAX];
+  if (getcwd(cwd, sizeof(cwd)) == NULL){
+    return -1;
+  }
+  add_key_part(&ctx, cwd, strlen(cwd));
+  /* an argument naming no file adds a part of its own, so it is not mistaken for the next one */
+  for (int i = 1; i < argc; i++){
+    if (stat(argv[i], &st) == 0){
+      add_key_file(&ctx, &st);
+    } else {
+      add_key_part(&ctx, "", 0);
+    }
+  }
+  if (in_fd != -1){
+    off_t offset = lseek(in_fd, 0, SEEK_CUR);
+    if (fstat(in_fd, &st) == -1){
+      return -1;
+    }
+    add_key_file(&ctx, &st);
+    add_key_part(&ctx, &offset, sizeof(offset));
+  }
+  sha256_final(&ctx, key->hex);
+  return 0;
+}
+
+int replay_cached(const cache_key_t *key, int out_fd){
+  if (init_cache() == -1){
+    return -1;
+  }
+  /* the key's link reads "status object" */
+  char link[sizeof(key->hex) + 5], target[128];
+  snprintf(link, sizeof(link), "keys/%s", key->hex);
+  ssize_t len = readlinkat(cache.fd, link, target, sizeof(target) - 1);
+  if (len == -1){
+    return -1;
+  }
+  target[len] = '\0';
+  int status;
+  char object[80] = "objects/";
+  if (sscanf(target, "%d %64s", &status, object + 8) != 2){
+    return -1;
+  }
+  int fd = openat(cache.fd, object, O_RDONLY | O_CLOEXEC);
+  if (fd == -1){
+    /* its output was evicted, the key goes too */
+    unlinkat(cache.fd, link, 0);
+    return -1;
+  }
+  /* the object was just used, which is what eviction goes by */
+  futimens(fd, NULL);
+  if (copy_fd(fd, out_fd) == -1){
+    perror("cache");
+  }
+  close(fd);
+  cache.hits++;
+  return status;
+}
+
+char *cache_temp_path(){
+  if (init_cache() == -1){
+    return NULL;
+  }
+  snprintf(cache.temp, sizeof(cache.temp), "%s/tmp/out.%d.%lu", cache.path, (int) getpid(),
+    cache.next_temp++);
+  return cache.temp;
+}
+
+/* reads the objects of the store into *objects (NULL if there are none or on failure), returns
+   how many there are, adding up their sizes into total */
+static size_t read_objects(cache_object_t **objects, off_t *total){
+  *objects = NULL;
+  *total = 0;
+  int dir_fd = openat(cache.fd, "objects", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  DIR *dir = dir_fd != -1 ? fdopendir(dir_fd) : NULL;
+  if (dir == NULL){
+    if (dir_fd != -1){
+      close(dir_fd);
+    }
+    return 0;
+  }
+  size_t count = 0, capacity = 0;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL){
+    struct stat st;
+    if (strlen(entry->d_name) != 64 || fstatat(dirfd(dir), entry->d_name, &st, 0) == -1){
+      continue;
+    }
+    if (count == capacity){
+      capacity = capacity ? capacity * 2 : 256;
+      cache_object_t *grown = (cache_object_t *) realloc(*objects,
+        capacity * sizeof(cache_object_t));
+      if (grown == NULL){
+        break;
+      }
+      *objects = grown;
+    }
+    cache_object_t *object = &(*objects)[count++];
+    memcpy(object->name, entry->d_name, sizeof(object->name));
+    object->used = st.st_mtim;
+    object->size = st.st_size;
+    *total += st.st_size;
+  }
+  closedir(dir);
+  return count;
+}
+
+/* drops the keys whose object is gone, returns how many keys are left */
+static long prune_keys(){
+  int dir_fd = openat(cache.fd, "keys", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  DIR *dir = dir_fd != -1 ? fdopendir(dir_fd) : NULL;
+  if (dir == NULL){
+    if (dir_fd != -1){
+      close(dir_fd);
+    }
+    return 0;
+  }
+  long left = 0;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL){
+    if (entry->d_name[0] == '.'){
+      continue;
+    }
+    char target[128], object[80] = "objects/";
+    ssize_t len = readlinkat(dirfd(dir), entry->d_name, target, sizeof(target) - 1);
+    int status;
+    if (len != -1){
+      target[len] = '\0';
+    }
+    if (len == -1 || sscanf(target, "%d %64s", &status, object + 8) != 2
+        || faccessat(cache.fd, object, F_OK, 0) == -1){
+      unlinkat(dirfd(dir), entry->d_name, 0);
+    } else {
+      left++;
+    }
+  }
+  closedir(dir);
+  return left;
+}
+
+/* the object used longest ago first */
+static int compare_objects(const void *a, const void *b){
+  const struct timespec *x = &((const cache_object_t *) a)->used;
+  const struct timespec *y = &((const cache_object_t *) b)->used;
+  if (x->tv_sec != y->tv_sec){
+    return x->tv_sec < y->tv_sec ? -1 : 1;
+  }
+  return x->tv_nsec < y->tv_nsec ? -1 : x->tv_nsec > y->tv_nsec;
+}
+
+/* counts the store's size, and if it is over the limit removes the objects used longest ago
+   until it is well under it, along with their keys */
+static void evict(){
+  cache_object_t *objects;
+  size_t count = read_objects(&objects, &cache.size);
+  if (cache.size > cache.limit){
+    qsort(objects, count, sizeof(cache_object_t), compare_objects);
+    off_t target = cache.limit / 100 * CACHE_EVICT_TO;
+    for (size_t i = 0; i < count && cache.size > target; i++){
+      char object[80];
+      snprintf(object, sizeof(object), "objects/%s", objects[i].name);
+      if (unlinkat(cache.fd, object, 0) == 0){
+        cache.size -= objects[i].size;
+        cache.evicted++;
+      }
+    }
+    prune_keys();
+  }
+  free(objects);
+}
+
+int store_cached(const cache_key_t *key, const char *temp_path, int status, int out_fd){
+  int fd = open(temp_path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1){
+    return 0;
+  }
+  int result = copy_fd(fd, out_fd);
+  int error = errno;
+  cache.misses++;
+  if (status < 0 || status >= 126 || cache.fd == -1){
+    close(fd);
+    unlink(temp_path);
+    errno = error;
+    return result;
+  }
+  /* the object is named by the hash of what it holds */
+  sha256_t ctx;
+  sha256_init(&ctx);
+  static char buffer[65536];
+  ssize_t n;
+  off_t size = 0;
+  while ((n = pread(fd, buffer, sizeof(buffer), size)) > 0){
+    sha256_update(&ctx, buffer, (size_t) n);
+    size += n;
+  }
+  close(fd);
+  char target[80];
+  int len = snprintf(target, sizeof(target), "%d ", status);
+  sha256_final(&ctx, target + len);
+  char object[80], link[80], temp_link[80];
+  snprintf(object, sizeof(object), "objects/%s", target + len);
+  snprintf(link, sizeof(link), "keys/%s", key->hex);
+  snprintf(temp_link, sizeof(temp_link), "tmp/key.%d.%lu", (int) getpid(), cache.next_temp++);
+  /* an output already stored is kept once, and just counts as used */
+  if (faccessat(cache.fd, object, F_OK, 0) == 0){
+    unlink(temp_path);
+    utimensat(cache.fd, object, NULL, 0);
+  } else if (renameat(AT_FDCWD, temp_path, cache.fd, object) == 0){
+    if (cache.size != -1){
+      cache.size += size;
+    }
+  } else {
+    unlink(temp_path);
+    errno = error;
+    return result;
+  }
+  /* the key's link is replaced all at once, so no other shell sees it half made */
+  if (symlinkat(target, cache.fd, temp_link) == 0
+      && renameat(cache.fd, temp_link, cache.fd, link) == -1){
+    unlinkat(cache.fd, temp_link, 0);
+  }
+  if (cache.size == -1 || cache.size > cache.limit){
+    evict();
+  }
+  errno = error;
+  return result;
+}
+
+void set_cache_limit(off_t limit){
+  cache.limit = limit;
+  if (init_cache() == 0){
+    evict();
+  }
+}
+
+off_t get_cache_limit(){
+  init_cache();
+  return cache.limit;
+}
+
+int clear_cache(){
+  if (init_cache() == -1){
+    return -1;
+  }
+  off_t limit = cache.limit;
+  long evicted = cache.evicted;
+  cache.limit = 0;
+  evict();
+  cache.limit = limit;
+  cache.evicted = evicted;
+  return 0;
+}
+
+void print_cache_stats(){
+  if (init_cache() == -1){
+    printf("no store\n");
+  } else {
+    cache_object_t *objects;
+    size_t count = read_objects(&objects, &cache.size);
+    free(objects);
+    long keys = prune_keys();
+    printf("store %s\n", cache.path);
+    printf("%ld commands, %zu outputs, %lld bytes of %lld\n", keys, count,
+      (long long) cache.size, (long long) cache.limit);
+  }
+  printf("%ld hits, %ld misses, %ld evicted\n", cache.hits, cache.misses, cache.evicted);
+}
@@ -0,0 +1,62 @@
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include <sys/types.h>
+
+/*
+ * The store the cache builtin keeps the output of commands in, so a deterministic command run
+ * again on the same inputs has its standard output and exit status replayed instead. A command
+ * is known by a key, the SHA-256 of its arguments, the identity (device, inode, size, times) of
+ * its executable, of every file its arguments name and of the file its standard input is
+ * redirected from, and of the working directory. The outputs are content addressed: each is
+ * kept once, in objects/ under the SHA-256 of its bytes, and keys/ has a symbolic link for each
+ * key reading "status object". The store is in $SH33_CACHE_DIR, or else 33sh under
+ * $XDG_CACHE_HOME or ~/.cache, and is kept under a size limit by evicting the objects used
+ * longest ago.
+ */
+
+/* a command's key, as hex */
+typedef struct cache_key {
+  char hex[65];
+} cache_key_t;
+
+/*
+ * computes the key of a command: its arguments (argv[0] as typed), the program it runs (path),
+ * and in_fd, the file its standard input is redirected from (-1 if none), from its offset on
+ * returns 0 on success, -1 on failure with errno set
+ */
+int make_cache_key(cache_key_t *key, char **argv, const char *path, int in_fd);
+
+/*
+ * writes the output stored for key to out_fd
+ * returns the exit status stored with it on a hit, -1 on a miss (nothing written)
+ */
+int replay_cached(const cache_key_t *key, int out_fd);
+
+/* gets a path in the store for a command's output to be written to, returns NULL if there is no
+   store (the command is then not cached), the path stays valid until the next call */
+char *cache_temp_path();
+
+/*
+ * copies the output a command wrote to temp_path to out_fd, then stores it for key with its exit
+ * status, unless the status says it could not be run or was killed (126 and up), evicting what
+ * it takes to stay under the limit
+ * returns 0 on success, -1 if the output could not be copied to out_fd (errno set)
+ */
+int store_cached(const cache_key_t *key, const char *temp_path, int status, int out_fd);
+
+/* parses a size in bytes, which may end in K, M or G, returns 0 on success, -1 if it is not one */
+int parse_cache_size(const char *text, off_t *size);
+
+/* sets and gets the size limit of the store in bytes (SH33_CACHE_SIZE, or 256 MiB, to begin
+   with), setting it evicts what is over it */
+void set_cache_limit(off_t limit);
+off_t get_cache_limit();
+
+/* removes every entry of the store, returns 0 on success, -1 if there is no store */
+int clear_cache();
+
+/* prints the store's place, size and limit, and this shell's hits, misses and evictions */
+void print_cache_stats();
+
+#endif  // CACHE_H_
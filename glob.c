@@ -0,0 +1,444 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "glob.h"
+
+/* the most a getdents64() call is given, enough for a couple of thousand entries at once */
+#define GLOB_DENTS_SIZE (64 * 1024)
+/* the most threads walking a "**", the shell's own included */
+#define GLOB_MAX_WORKERS 4
+
+/* a growing array of malloc'd paths, failed set if one could not be added */
+typedef struct glob_paths {
+  char **paths;
+  size_t count;
+  size_t capacity;
+  int failed;
+} glob_paths_t;
+
+/* the entries of a directory as getdents64() gives them, in buf, with the directory open as fd
+   for the entries whose d_type doesn't tell what they are */
+typedef struct glob_listing {
+  int fd;
+  char *buf;
+  size_t len;
+  size_t capacity;
+} glob_listing_t;
+
+/* one component of a pattern, unescaped if it is not a pattern itself */
+typedef struct glob_component {
+  char *text;
+  int pattern;
+} glob_component_t;
+
+/* a "**" walk: the components after it (everything set if there are none, or just a '/', so
+   all that is below matches, or all the directories), and the directories still to read and the
+   number being read, which the workers share under lock */
+typedef struct glob_walk {
+  glob_component_t *rest;
+  int num_rest;
+  int everything;
+  glob_paths_t dirs;
+  int busy;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+} glob_walk_t;
+
+/* one thread of a walk, with the paths it matched */
+typedef struct glob_worker {
+  glob_walk_t *walk;
+  glob_paths_t matches;
+  pthread_t thread;
+} glob_worker_t;
+
+static void expand(const char *prefix, glob_component_t *comps, int n, glob_paths_t *matches,
+  int nested);
+
+int is_glob_pattern(const char *pattern){
+  for (const char *c = pattern; *c != '\0'; c++){
+    if (*c == '\\' && c[1] != '\0'){
+      c++;
+    } else if (*c == '*' || *c == '?' || (*c == '[' && strchr(c + 1, ']') != NULL)){
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* joins prefix, name and suffix into a malloc'd path, returns NULL if out of memory */
+static char *join_path(const char *prefix, const char *name, const char *suffix){
+  size_t prefix_len = strlen(prefix), name_len = strlen(name), suffix_len = strlen(suffix);
+  char *path = (char *) malloc(prefix_len + name_len + suffix_len + 1);
+  if (path != NULL){
+    memcpy(path, prefix, prefix_len);
+    memcpy(path + prefix_len, name, name_len);
+    memcpy(path + prefix_len + name_len, suffix, suffix_len + 1);
+  }
+  return path;
+}
+
+/* makes room for count more paths, returns 0 on success, -1 (noting the failure) else */
+static int reserve_paths(glob_paths_t *paths, size_t count){
+  if (paths->capacity - paths->count >= count){
+    return 0;
+  }
+  size_t capacity = paths->capacity ? paths->capacity : 64;
+  while (capacity - paths->count < count){
+    capacity *= 2;
+  }
+  char **grown = (char **) realloc(paths->paths, capacity * sizeof(char *));
+  if (grown == NULL){
+    paths->failed = 1;
+    return -1;
+  }
+  paths->paths = grown;
+  paths->capacity = capacity;
+  return 0;
+}
+
+/* adds prefix, name and suffix as one path */
+static void add_path(glob_paths_t *paths, const char *prefix, const char *name,
+  const char *suffix){
+  if (reserve_paths(paths, 1) == -1){
+    return;
+  }
+  char *path = join_path(prefix, name, suffix);
+  if (path == NULL){
+    paths->failed = 1;
+    return;
+  }
+  paths->paths[paths->count++] = path;
+}
+
+/* moves the paths of from to the end of to, leaving from empty (but keeping its array) */
+static void move_paths(glob_paths_t *to, glob_paths_t *from){
+  to->failed |= from->failed;
+  if (from->count == 0){
+    return;
+  }
+  if (reserve_paths(to, from->count) == 0){
+    memcpy(to->paths + to->count, from->paths, from->count * sizeof(char *));
+    to->count += from->count;
+  } else {
+    for (size_t i = 0; i < from->count; i++){
+      free(from->paths[i]);
+    }
+  }
+  from->count = 0;
+  from->failed = 0;
+}
+
+static void free_paths(glob_paths_t *paths){
+  for (size_t i = 0; i < paths->count; i++){
+    free(paths->paths[i]);
+  }
+  free(paths->paths);
+}
+
+/* reads the entries of the directory at path ("" for the working directory) into listing,
+   reusing its buffer, and leaves it open, returns 0 on success, -1 if it could not be read */
+static int read_listing(glob_listing_t *listing, const char *path){
+  listing->fd = open(*path != '\0' ? path : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (listing->fd == -1){
+    return -1;
+  }
+  listing->len = 0;
+  while(1){
+    /* a big directory doubles the buffer, so it is read in ever fewer calls */
+    if (listing->capacity - listing->len < sizeof(struct dirent64)){
+      size_t capacity = listing->capacity ? listing->capacity * 2 : GLOB_DENTS_SIZE;
+      char *grown = (char *) realloc(listing->buf, capacity);
+      if (grown == NULL){
+        break;
+      }
+      listing->buf = grown;
+      listing->capacity = capacity;
+    }
+    size_t room = listing->capacity - listing->len;
+    ssize_t n = getdents64(listing->fd, listing->buf + listing->len,
+      room < GLOB_DENTS_SIZE ? room : GLOB_DENTS_SIZE);
+    if (n == 0){
+      return 0;
+    }
+    if (n == -1){
+      break;
+    }
+    listing->len += (size_t) n;
+  }
+  close(listing->fd);
+  listing->fd = -1;
+  return -1;
+}
+
+/* the entry of a listing at *at, moving *at to the next one */
+static struct dirent64 *next_entry(const glob_listing_t *listing, size_t *at){
+  struct dirent64 *entry = (struct dirent64 *) (listing->buf + *at);
+  *at += entry->d_reclen;
+  return entry;
+}
+
+/* 1 if an entry of the directory dir_fd is a directory, going by its d_type and only asking
+   stat() when that doesn't say, a symbolic link counting as what it points to if follow is set */
+static int is_dir(int dir_fd, const struct dirent64 *entry, int follow){
+  if (entry->d_type == DT_DIR){
+    return 1;
+  }
+  if (entry->d_type != DT_UNKNOWN && (entry->d_type != DT_LNK || !follow)){
+    return 0;
+  }
+  struct stat st;
+  return fstatat(dir_fd, entry->d_name, &st, follow ? 0 : AT_SYMLINK_NOFOLLOW) == 0
+    && S_ISDIR(st.st_mode);
+}
+
+static int is_dot_or_dotdot(const char *name){
+  return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+/* matches the first of n components against the entries of the directory prefix, listed, and
+   expands the rest in the directories that match it */
+static void match_listing(const glob_listing_t *listing, const char *prefix,
+  glob_component_t *comps, int n, glob_paths_t *matches, int nested){
+  for (size_t at = 0; at < listing->len;){
+    struct dirent64 *entry = next_entry(listing, &at);
+    if (is_dot_or_dotdot(entry->d_name) || fnmatch(comps[0].text, entry->d_name, FNM_PERIOD)){
+      continue;
+    }
+    if (n == 1){
+      add_path(matches, prefix, entry->d_name, "");
+    } else if (is_dir(listing->fd, entry, 1)){
+      char *next = join_path(prefix, entry->d_name, "/");
+      if (next == NULL){
+        matches->failed = 1;
+        continue;
+      }
+      expand(next, comps + 1, n - 1, matches, nested);
+      free(next);
+    }
+  }
+}
+
+/* reads one directory of a walk, queueing the directories in it (but hidden ones and symbolic
+   links) in subdirs and matching the rest of the pattern in it */
+static void walk_dir(glob_walk_t *walk, const char *dir, glob_listing_t *listing,
+  glob_paths_t *subdirs, glob_paths_t *matches){
+  if (!walk->everything && !walk->rest[0].pattern){
+    expand(dir, walk->rest, walk->num_rest, matches, 1);
+  }
+  if (read_listing(listing, dir) == -1){
+    return;
+  }
+  for (size_t at = 0; at < listing->len;){
+    struct dirent64 *entry = next_entry(listing, &at);
+    if (entry->d_name[0] == '.'){
+      continue;
+    }
+    if (is_dir(listing->fd, entry, 0)){
+      add_path(subdirs, dir, entry->d_name, "/");
+    }
+    if (walk->everything && (walk->num_rest == 0 || is_dir(listing->fd, entry, 1))){
+      add_path(matches, dir, entry->d_name, walk->num_rest == 0 ? "" : "/");
+    }
+  }
+  if (!walk->everything && walk->rest[0].pattern){
+    match_listing(listing, dir, walk->rest, walk->num_rest, matches, 1);
+  }
+  close(listing->fd);
+}
+
+/* a thread of a walk, taking directories off the stack until it is empty and none is being
+   read, which could add more */
+static void *walk_worker(void *arg){
+  glob_worker_t *worker = (glob_worker_t *) arg;
+  glob_walk_t *walk = worker->walk;
+  glob_listing_t listing = {-1, NULL, 0, 0};
+  glob_paths_t subdirs = {NULL, 0, 0, 0};
+  pthread_mutex_lock(&walk->lock);
+  while(1){
+    while (walk->dirs.count == 0 && walk->busy > 0){
+      pthread_cond_wait(&walk->changed, &walk->lock);
+    }
+    if (walk->dirs.count == 0){
+      break;
+    }
+    char *dir = walk->dirs.paths[--walk->dirs.count];
+    walk->busy++;
+    pthread_mutex_unlock(&walk->lock);
+    walk_dir(walk, dir, &listing, &subdirs, &worker->matches);
+    free(dir);
+    pthread_mutex_lock(&walk->lock);
+    move_paths(&walk->dirs, &subdirs);
+    walk->busy--;
+    pthread_cond_broadcast(&walk->changed);
+  }
+  pthread_mutex_unlock(&walk->lock);
+  free(listing.buf);
+  free(subdirs.paths);
+  return NULL;
+}
+
+/* expands "**" and the components after it under prefix: they are matched in prefix and in
+   every directory below it, read by a pool of threads unless the walk is nested in another */
+static void walk(const char *prefix, glob_component_t *rest, int num_rest,
+  glob_paths_t *matches, int nested){
+  int everything = num_rest == 0 || (num_rest == 1 && !rest[0].pattern && *rest[0].text == '\0');
+  glob_walk_t walk = {rest, num_rest, everything, {NULL, 0, 0, 0}, 0,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+  add_path(&walk.dirs, prefix, "", "");
+  if (everything && *prefix != '\0'){
+    add_path(matches, prefix, "", "");
+  }
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  int num_workers = nested || cpus < 1 ? 1 : (cpus < GLOB_MAX_WORKERS ? (int) cpus
+    : GLOB_MAX_WORKERS);
+  glob_worker_t workers[GLOB_MAX_WORKERS];
+  for (int i = 0; i < num_workers; i++){
+    workers[i].walk = &walk;
+    memset(&workers[i].matches, 0, sizeof(glob_paths_t));
+  }
+  /* the threads take no signals, they are all the shell's */
+  sigset_t all, saved;
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, &saved);
+  int started = 1;
+  while (started < num_workers
+      && pthread_create(&workers[started].thread, NULL, walk_worker, &workers[started]) == 0){
+    started++;
+  }
+  pthread_sigmask(SIG_SETMASK, &saved, NULL);
+  walk_worker(&workers[0]);
+  for (int i = 1; i < started; i++){
+    pthread_join(workers[i].thread, NULL);
+  }
+  for (int i = 0; i < started; i++){
+    move_paths(matches, &workers[i].matches);
+    free(workers[i].matches.paths);
+  }
+  matches->failed |= walk.dirs.failed;
+  free_paths(&walk.dirs);
+  pthread_mutex_destroy(&walk.lock);
+  pthread_cond_destroy(&walk.changed);
+}
+
+/* expands n components under prefix ("" or ending in '/'), adding the paths they match */
+static void expand(const char *prefix, glob_component_t *comps, int n, glob_paths_t *matches,
+  int nested){
+  if (!comps[0].pattern){
+    /* a literal component just goes on the prefix, whether the path is there is only asked at
+       the end */
+    struct stat st;
+    char *next = join_path(prefix, comps[0].text, n == 1 ? "" : "/");
+    if (next == NULL){
+      matches->failed = 1;
+    } else if (n > 1){
+      expand(next, comps + 1, n - 1, matches, nested);
+    } else if (lstat(next, &st) == 0){
+      add_path(matches, next, "", "");
+    }
+    free(next);
+    return;
+  }
+  if (!strcmp(comps[0].text, "**")){
+    walk(prefix, comps + 1, n - 1, matches, nested);
+    return;
+  }
+  glob_listing_t listing = {-1, NULL, 0, 0};
+  if (read_listing(&listing, prefix) == 0){
+    match_listing(&listing, prefix, comps, n, matches, nested);
+    close(listing.fd);
+  }
+  free(listing.buf);
+}
+
+static int compare_paths(const void *a, const void *b){
+  return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+/* removes the backslashes escaping characters of a pattern, in place */
+static void unescape(char *text){
+  char *out = text;
+  for (char *c = text; *c != '\0'; c++){
+    if (*c == '\\' && c[1] != '\0'){
+      c++;
+    }
+    *out++ = *c;
+  }
+  *out = '\0';
+}
+
+int expand_glob(const char *pattern, arena_t *arena, char ***matches, size_t *num_matches){
+  *matches = NULL;
+  *num_matches = 0;
+  /* the pattern is split at '/' in a copy, an absolute one starting from "/" */
+  char *copy = strdup(pattern);
+  int num_comps = 1;
+  for (const char *c = pattern; *c != '\0'; c++){
+    num_comps += *c == '/';
+  }
+  glob_component_t *comps = (glob_component_t *) malloc((size_t) num_comps
+    * sizeof(glob_component_t));
+  if (copy == NULL || comps == NULL){
+    free(copy);
+    free(comps);
+    errno = ENOMEM;
+    return -1;
+  }
+  const char *prefix = *copy == '/' ? "/" : "";
+  char *start = *copy == '/' ? copy + 1 : copy;
+  int n = 0;
+  while(1){
+    char *slash = strchr(start, '/');
+    if (slash != NULL){
+      *slash = '\0';
+    }
+    comps[n].text = start;
+    comps[n].pattern = is_glob_pattern(start);
+    if (!comps[n].pattern){
+      unescape(start);
+    }
+    n++;
+    if (slash == NULL){
+      break;
+    }
+    start = slash + 1;
+  }
+  glob_paths_t found = {NULL, 0, 0, 0};
+  expand(prefix, comps, n, &found, 0);
+  free(comps);
+  free(copy);
+  /* the matches go to the arena in order, once each, as "**" after "**" can find a path twice */
+  int failed = found.failed;
+  if (!failed && found.count > 0){
+    qsort(found.paths, found.count, sizeof(char *), compare_paths);
+    *matches = (char **) arena_alloc(arena, found.count * sizeof(char *));
+    failed = *matches == NULL;
+    for (size_t i = 0; i < found.count && !failed; i++){
+      if (i > 0 && !strcmp(found.paths[i], found.paths[i - 1])){
+        continue;
+      }
+      size_t len = strlen(found.paths[i]) + 1;
+      char *path = (char *) arena_alloc(arena, len);
+      if (path == NULL){
+        failed = 1;
+        break;
+      }
+      memcpy(path, found.paths[i], len);
+      (*matches)[(*num_matches)++] = path;
+    }
+  }
+  free_paths(&found);
+  if (failed){
+    *matches = NULL;
+    *num_matches = 0;
+    errno = ENOMEM;
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,28 @@
+#ifndef GLOB_H_
+#define GLOB_H_
+
+#include <stddef.h>
+#include "arena.h"
+
+/*
+ * Pathname expansion of the words the lexer marks as patterns (see lexer.h): a pattern is split
+ * at '/', and each component with *, ? or [...] in it is matched against the entries of the
+ * directories matched so far, which are read with large getdents64() calls and told apart as
+ * directories by their d_type, without a stat() each. A component that is just "**" matches any
+ * number of directories below, hidden ones and symbolic links aside, which a small pool of
+ * threads walks, each taking the next directory to read from a shared stack. As in other shells,
+ * a leading '.' is only matched by a '.' in the pattern, and "." and ".." never are.
+ */
+
+/* 1 if pattern has an unescaped *, ? or [...], so expanding it means reading directories, 0 if
+   it only names itself */
+int is_glob_pattern(const char *pattern);
+
+/*
+ * expands pattern into the paths it matches, sorted by strcmp(), as an array of *num_matches
+ * strings allocated from arena (0 and NULL if nothing matches)
+ * returns 0 on success, -1 if out of memory
+ */
+int expand_glob(const char *pattern, arena_t *arena, char ***matches, size_t *num_matches);
+
+#endif  // GLOB_H_
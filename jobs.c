@@ -2,31 +2,395 @@
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/pidfd.h>
 #include "./jobs.h"
 
+// number of job elements (or processes) carved out of each slab
+#define JOB_SLAB_SIZE 64
+// commands up to this long (with the '\0') are kept in the job element itself
+#define JOB_COMMAND_INLINE 48
+// initial number of buckets in each hash index, 2 ^ JOB_INITIAL_BITS
+#define JOB_INITIAL_BITS 6
+#define JOB_INITIAL_BUCKETS (1 << JOB_INITIAL_BITS)
+// signals a pidfd's whole process group (Linux 6.9), missing from older headers
+#ifndef PIDFD_SIGNAL_PROCESS_GROUP
+#define PIDFD_SIGNAL_PROCESS_GROUP (1UL << 2)
+#endif
+
+struct job_element;
+
+// one process of a job, pidfd is -1 once it is reaped (or if it has none)
+struct job_process {
+    pid_t pid;
+    int pidfd;
+    int running;
+    struct job_element *job;
+    // next process of the same job, in pipeline order
+    struct job_process *next;
+    // hash chain of the PID index
+    struct job_process *pid_next;
+};
+typedef struct job_process job_process_t;
+
+// pid is the first process's PID, which is also the job's process group
+// the first process is kept in the element itself, later ones come from the
+// process pool, and command points to command_buf unless it is too long
 struct job_element {
     int jid;
     pid_t pid;
     process_state_t state;
     char *command;
+    char command_buf[JOB_COMMAND_INLINE];
+    job_process_t first;
+    job_process_t *last;
+    int num_running;
+    int status;
+    // summed over the processes reaped so far
+    struct rusage usage;
+    // when the job was added, on the wall clock and the monotonic clock
+    time_t started_at;
+    struct timespec started;
+    // largest resident set sampled from a running process, in KiB
+    long peak_rss;
+    // the CPUs the job was placed on (NULL if it wasn't) and its NUMA node
+    cpu_set_t *cpus;
+    int node;
+    // insertion order, used by jobs() and get_next_pid()
+    struct job_element *prev;
     struct job_element *next;
+    // hash chain of the JID index
+    struct job_element *jid_next;
 };
 typedef struct job_element job_element_t;
 
-// head is the head of the list
+// job elements and processes are allocated JOB_SLAB_SIZE at a time and
+// recycled through a free list (linked through each free item's first bytes),
+// so adding and removing jobs does not go to malloc once the pools are big
+// enough
+// the items are aligned like job_align, which covers what they hold
+union job_align {
+    long long ll;
+    void *ptr;
+};
+struct job_slab {
+    struct job_slab *next;
+    union job_align items[];
+};
+typedef struct job_slab job_slab_t;
+
+struct job_pool {
+    void *free_items;
+    job_slab_t *slabs;
+    size_t item_size;
+};
+typedef struct job_pool job_pool_t;
+
+// names of the states, for jobs()
+static const char *const state_names[] = {
+    [_STATE_RUNNING] = "Running",
+    [_STATE_STOPPED] = "Stopped"
+};
+
+// head and tail are the ends of the list in insertion order
 // current is the current element being iterated over
+// jid_index (of jobs) and pid_index (of processes) are hash tables of
+// num_buckets chains each
+// epoll_fd has every running process's pidfd registered with its PID,
+// num_untracked counts the running processes that could not get a pidfd
 struct job_list {
     job_element_t *head;
+    job_element_t *tail;
     job_element_t *current;
+    job_element_t **jid_index;
+    job_process_t **pid_index;
+    size_t num_buckets;
+    unsigned int bucket_shift;
+    size_t num_jobs;
+    size_t num_processes;
+    int epoll_fd;
+    size_t num_untracked;
+    job_pool_t element_pool;
+    job_pool_t process_pool;
     pid_t shell_pid;
 };
 
+/* hashes a JID or PID into a bucket of the index */
+static size_t job_bucket(job_list_t *job_list, unsigned int key) {
+    // Fibonacci hashing spreads consecutive JIDs and PIDs over the table
+    return (size_t) ((key * 2654435769u) >> job_list->bucket_shift);
+}
+
+/* sets up an empty pool of items of item_size bytes */
+static void init_pool(job_pool_t *pool, size_t item_size) {
+    pool->free_items = NULL;
+    pool->slabs = NULL;
+    pool->item_size = item_size;
+}
+
+/* takes an item from the pool's free list, carving a new slab if it is empty */
+static void *pool_alloc(job_pool_t *pool) {
+    if (pool->free_items == NULL) {
+        job_slab_t *slab = (job_slab_t *)
+            malloc(sizeof(job_slab_t) + JOB_SLAB_SIZE * pool->item_size);
+        if (slab == NULL) {
+            return NULL;
+        }
+        slab->next = pool->slabs;
+        pool->slabs = slab;
+        char *items = (char *) slab->items;
+        for (int i = JOB_SLAB_SIZE - 1; i >= 0; i--) {
+            void *item = items + (size_t) i * pool->item_size;
+            *(void **) item = pool->free_items;
+            pool->free_items = item;
+        }
+    }
+
+    void *item = pool->free_items;
+    pool->free_items = *(void **) item;
+    return item;
+}
+
+/* returns an item to the pool's free list */
+static void pool_free(job_pool_t *pool, void *item) {
+    *(void **) item = pool->free_items;
+    pool->free_items = item;
+}
+
+/* frees the pool's slabs, and with them every item */
+static void destroy_pool(job_pool_t *pool) {
+    job_slab_t *slab = pool->slabs;
+    while (slab != NULL) {
+        job_slab_t *next = slab->next;
+        free(slab);
+        slab = next;
+    }
+    init_pool(pool, pool->item_size);
+}
+
+/* closes a process's pidfd, which also takes it out of the epoll set */
+static void close_pidfd(job_list_t *job_list, job_process_t *proc) {
+    if (proc->pidfd != -1) {
+        close(proc->pidfd);
+        proc->pidfd = -1;
+    } else if (proc->running) {
+        job_list->num_untracked--;
+    }
+    proc->running = 0;
+}
+
+/* returns a job element's command and processes and then the element itself
+   to their pools */
+static void free_element(job_list_t *job_list, job_element_t *element) {
+    job_process_t *proc = &element->first;
+    while (proc != NULL) {
+        job_process_t *next = proc->next;
+        close_pidfd(job_list, proc);
+        if (proc != &element->first) {
+            pool_free(&job_list->process_pool, proc);
+        }
+        proc = next;
+    }
+
+    if (element->command != element->command_buf) {
+        free(element->command);
+    }
+    element->command = NULL;
+    free(element->cpus);
+    element->cpus = NULL;
+
+    pool_free(&job_list->element_pool, element);
+}
+
+/* doubles the number of buckets and rehashes both indexes, returns 0 on success */
+static int grow_indexes(job_list_t *job_list) {
+    size_t num_buckets = job_list->num_buckets * 2;
+    job_element_t **jid_index =
+        (job_element_t **) calloc(num_buckets, sizeof(job_element_t *));
+    job_process_t **pid_index =
+        (job_process_t **) calloc(num_buckets, sizeof(job_process_t *));
+    if (jid_index == NULL || pid_index == NULL) {
+        free(jid_index);
+        free(pid_index);
+        return -1;
+    }
+
+    free(job_list->jid_index);
+    free(job_list->pid_index);
+    job_list->jid_index = jid_index;
+    job_list->pid_index = pid_index;
+    job_list->num_buckets = num_buckets;
+    job_list->bucket_shift--;
+
+    // the insertion order list still holds every job, so rebuild from it
+    for (job_element_t *cur = job_list->head; cur != NULL; cur = cur->next) {
+        size_t jb = job_bucket(job_list, (unsigned int) cur->jid);
+        cur->jid_next = jid_index[jb];
+        jid_index[jb] = cur;
+        for (job_process_t *proc = &cur->first; proc != NULL; proc = proc->next) {
+            size_t pb = job_bucket(job_list, (unsigned int) proc->pid);
+            proc->pid_next = pid_index[pb];
+            pid_index[pb] = proc;
+        }
+    }
+
+    return 0;
+}
+
+/* makes room in the indexes for one more job or process, returns 0 on success */
+static int reserve_indexes(job_list_t *job_list) {
+    if (job_list->num_jobs >= job_list->num_buckets
+            || job_list->num_processes >= job_list->num_buckets) {
+        return grow_indexes(job_list);
+    }
+    return 0;
+}
+
+/* finds a job given its JID, returns NULL if there is none */
+static job_element_t *find_jid(job_list_t *job_list, int jid) {
+    job_element_t *cur =
+        job_list->jid_index[job_bucket(job_list, (unsigned int) jid)];
+    while (cur != NULL && cur->jid != jid) {
+        cur = cur->jid_next;
+    }
+    return cur;
+}
+
+/* finds a process given its PID, returns NULL if there is none */
+static job_process_t *find_pid(job_list_t *job_list, pid_t pid) {
+    job_process_t *cur =
+        job_list->pid_index[job_bucket(job_list, (unsigned int) pid)];
+    while (cur != NULL && cur->pid != pid) {
+        cur = cur->pid_next;
+    }
+    return cur;
+}
+
+/*
+ * sets up a new running process of job, opening its pidfd and adding it to
+ * the PID index, the pid can't be reused before we reap it, so opening the
+ * pidfd now is race free, its exit then shows up as an event on the epoll fd
+ */
+static void track_process(job_list_t *job_list, job_element_t *job,
+    job_process_t *proc, pid_t pid) {
+    proc->pid = pid;
+    proc->running = 1;
+    proc->job = job;
+    proc->next = NULL;
+
+    proc->pidfd = pidfd_open(pid, 0);
+    if (proc->pidfd != -1 && job_list->epoll_fd != -1) {
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u64 = (uint64_t) pid;
+        if (epoll_ctl(job_list->epoll_fd, EPOLL_CTL_ADD, proc->pidfd, &event) < 0) {
+            close(proc->pidfd);
+            proc->pidfd = -1;
+        }
+    }
+    if (proc->pidfd == -1) {
+        job_list->num_untracked++;
+    }
+
+    size_t pb = job_bucket(job_list, (unsigned int) pid);
+    proc->pid_next = job_list->pid_index[pb];
+    job_list->pid_index[pb] = proc;
+    job_list->num_processes++;
+    job->num_running++;
+}
+
+/* unlinks a job from the list and both indexes, and frees it */
+static void remove_element(job_list_t *job_list, job_element_t *element) {
+    job_element_t **link =
+        &job_list->jid_index[job_bucket(job_list, (unsigned int) element->jid)];
+    while (*link != element) {
+        link = &(*link)->jid_next;
+    }
+    *link = element->jid_next;
+
+    for (job_process_t *proc = &element->first; proc != NULL; proc = proc->next) {
+        job_process_t **plink =
+            &job_list->pid_index[job_bucket(job_list, (unsigned int) proc->pid)];
+        while (*plink != proc) {
+            plink = &(*plink)->pid_next;
+        }
+        *plink = proc->pid_next;
+        job_list->num_processes--;
+    }
+
+    if (element->prev != NULL) {
+        element->prev->next = element->next;
+    } else {
+        job_list->head = element->next;
+    }
+    if (element->next != NULL) {
+        element->next->prev = element->prev;
+    } else {
+        job_list->tail = element->prev;
+    }
+    if (job_list->current == element) {
+        job_list->current = element->next;
+    }
+
+    job_list->num_jobs--;
+    free_element(job_list, element);
+}
+
+/* adds a reaped process's resource usage into a job's, the peak resident set
+   is the largest of any one process as they are not added up by the kernel */
+static void add_usage(struct rusage *total, const struct rusage *usage) {
+    timeradd(&total->ru_utime, &usage->ru_utime, &total->ru_utime);
+    timeradd(&total->ru_stime, &usage->ru_stime, &total->ru_stime);
+    if (usage->ru_maxrss > total->ru_maxrss) {
+        total->ru_maxrss = usage->ru_maxrss;
+    }
+    total->ru_minflt += usage->ru_minflt;
+    total->ru_majflt += usage->ru_majflt;
+    total->ru_inblock += usage->ru_inblock;
+    total->ru_oublock += usage->ru_oublock;
+    total->ru_nvcsw += usage->ru_nvcsw;
+    total->ru_nivcsw += usage->ru_nivcsw;
+}
+
+/* checks that state is one of the states a job can be in */
+static int valid_state(process_state_t state) {
+    return state == _STATE_RUNNING || state == _STATE_STOPPED;
+}
+
 /* initializes job list, returns pointer */
 job_list_t *init_job_list() {
     job_list_t *job_list = (job_list_t *) malloc(sizeof(job_list_t));
+    if (job_list == NULL) {
+        return NULL;
+    }
     job_list->head = NULL;
+    job_list->tail = NULL;
     job_list->current = NULL;
+    job_list->num_buckets = JOB_INITIAL_BUCKETS;
+    job_list->bucket_shift = 32 - JOB_INITIAL_BITS;
+    job_list->num_jobs = 0;
+    job_list->num_processes = 0;
+    job_list->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    job_list->num_untracked = 0;
+    job_list->jid_index =
+        (job_element_t **) calloc(JOB_INITIAL_BUCKETS, sizeof(job_element_t *));
+    job_list->pid_index =
+        (job_process_t **) calloc(JOB_INITIAL_BUCKETS, sizeof(job_process_t *));
+    init_pool(&job_list->element_pool, sizeof(job_element_t));
+    init_pool(&job_list->process_pool, sizeof(job_process_t));
     job_list->shell_pid = getpid();
+    if (job_list->jid_index == NULL || job_list->pid_index == NULL) {
+        free(job_list->jid_index);
+        free(job_list->pid_index);
+        if (job_list->epoll_fd != -1) {
+            close(job_list->epoll_fd);
+        }
+        free(job_list);
+        return NULL;
+    }
     return job_list;
 }
 
@@ -43,211 +407,227 @@ void cleanup_job_list(job_list_t *job_list) {
     job_element_t *cur = job_list->head;
     while (cur != NULL) {
         job_element_t *nextElement = cur->next;
-	
-	// if we are cleaning up the shell's job list and not a child's
-		if (getpid() == job_list->shell_pid) {
-        /* kill process */
-        	if (kill(-cur->pid, SIGKILL) < 0) {
-            	perror("kill");
-        	}	
-		}
 
-        /* free strings */
-		if (cur->state != NULL) {
-        	free(cur->state);
-        	cur->state = NULL;
-    	}
-
-    	if (cur->command != NULL) {
-        	free(cur->command);
-        	cur->command = NULL;
-    	}
+        // if we are cleaning up the shell's job list and not a child's
+        if (getpid() == job_list->shell_pid) {
+            /* kill process */
+            if (signal_job(job_list, cur->jid, SIGKILL) < 0) {
+                perror("kill");
+            }
+        }
 
-        free(cur);
+        /* free strings */
+        free_element(job_list, cur);
         cur = nextElement;
     }
 
+    /* free the slabs, which hold every element and process */
+    destroy_pool(&job_list->element_pool);
+    destroy_pool(&job_list->process_pool);
+
+    free(job_list->jid_index);
+    free(job_list->pid_index);
+    if (job_list->epoll_fd != -1) {
+        close(job_list->epoll_fd);
+    }
     job_list->head = NULL;
+    job_list->tail = NULL;
     job_list->current = NULL;
+    job_list->jid_index = NULL;
+    job_list->pid_index = NULL;
+    job_list->epoll_fd = -1;
     job_list->shell_pid = 0;
 
     free(job_list);
 }
 
 /* adds new job to list, returns 0 on success, -1 on failure */
-int add_job(job_list_t *job_list, int jid, pid_t pid, 
+int add_job(job_list_t *job_list, int jid, pid_t pid,
     process_state_t state, char *command) {
-    if (job_list == NULL || state == NULL || command == NULL) {
+    if (job_list == NULL || !valid_state(state) || command == NULL) {
         return -1;
     }
 
-    job_element_t *new = (job_element_t *) malloc(sizeof(job_element_t));
+    if (reserve_indexes(job_list) < 0) {
+        return -1;
+    }
+
+    job_element_t *new = (job_element_t *) pool_alloc(&job_list->element_pool);
+    if (new == NULL) {
+        return -1;
+    }
     new->jid = jid;
     new->pid = pid;
+    new->state = state;
+    new->num_running = 0;
+    new->status = -1;
+    memset(&new->usage, 0, sizeof(new->usage));
+    new->started_at = time(NULL);
+    clock_gettime(CLOCK_MONOTONIC, &new->started);
+    new->peak_rss = 0;
+    new->cpus = NULL;
+    new->node = -1;
+    // nothing to close yet if we bail out below
+    new->first.pidfd = -1;
+    new->first.running = 0;
+    new->first.next = NULL;
 
-    // allocate new char*'s and copy buffers in to protect our code
-    size_t statelen = strlen(state);
-    new->state = (char *) malloc(sizeof(char) * (statelen + 1));
-    memcpy(new->state, state, statelen);
-    new->state[statelen] = 0;
-
+    // copy the command in to protect our code, into the element if it fits
     size_t cmdlen = strlen(command);
-    new->command = (char *) malloc(sizeof(char) * (cmdlen + 1));
+    new->command = new->command_buf;
+    if (cmdlen >= JOB_COMMAND_INLINE) {
+        new->command = (char *) malloc(sizeof(char) * (cmdlen + 1));
+    }
+    if (new->command == NULL) {
+        free_element(job_list, new);
+        return -1;
+    }
     memcpy(new->command, command, cmdlen);
     new->command[cmdlen] = 0;
-    new->next = NULL;
 
-    if (job_list->head == NULL) {
-        // add to head
+    track_process(job_list, new, &new->first, pid);
+    new->last = &new->first;
+
+    // add to tail
+    new->prev = job_list->tail;
+    new->next = NULL;
+    if (job_list->tail == NULL) {
         job_list->head = new;
         job_list->current = new;
     } else {
-        // add to tail
-        job_element_t *cur = job_list->head;
-        while (cur->next != NULL) {
-            cur = cur->next;
-        }
-        cur->next = new;
+        job_list->tail->next = new;
     }
+    job_list->tail = new;
 
+    // add to the front of the JID hash chain
+    size_t jb = job_bucket(job_list, (unsigned int) jid);
+    new->jid_next = job_list->jid_index[jb];
+    job_list->jid_index[jb] = new;
+
+    job_list->num_jobs++;
     return 0;
 }
 
-/* removes job from list, given job's JID, 
-    returns 0 on success, -1 on failure */
-int remove_job_jid(job_list_t *job_list, int jid) {
+/*
+ * adds another process to a job, given job's JID, e.g. a later stage of a
+ * pipeline, which must be in the job's process group
+ * returns 0 on success, -1 on failure
+ */
+int add_job_process(job_list_t *job_list, int jid, pid_t pid) {
     if (job_list == NULL) {
         return -1;
     }
 
-    job_element_t *prev = NULL;
-    job_element_t *cur = job_list->head;
-    while (cur != NULL) {
-        if (cur->jid == jid) {
-            if (prev != NULL) {
-                prev->next = cur->next;
-            }
-            if (job_list->head == cur) {
-                job_list->head = cur->next;
-            }
-            if (job_list->current == cur) {
-                job_list->current = cur->next;
-            }
+    if (reserve_indexes(job_list) < 0) {
+        return -1;
+    }
 
-            // free char*'s
-            if (cur->state != NULL) {
-                free(cur->state);
-                cur->state = NULL;
-            }
-            if (cur->command != NULL) {
-                free(cur->command);
-                cur->command = NULL;
-            }
+    job_element_t *job = find_jid(job_list, jid);
+    if (job == NULL) {
+        return -1;
+    }
 
-            free(cur);
-            cur = NULL;
+    job_process_t *proc = (job_process_t *) pool_alloc(&job_list->process_pool);
+    if (proc == NULL) {
+        return -1;
+    }
+    track_process(job_list, job, proc, pid);
+    job->last->next = proc;
+    job->last = proc;
+    return 0;
+}
 
-            return 0;
-        }
+/*
+ * marks one of a job's processes as reaped, given its PID, remembering status
+ * (as from waitpid) if it is the job's last process, i.e. its last stage
+ * returns the number of the job's processes still running, -1 on failure
+ */
+int reap_job_process(job_list_t *job_list, pid_t pid, int status,
+    const struct rusage *usage) {
+    if (job_list == NULL) {
+        return -1;
+    }
 
-        prev = cur;
-        cur = cur->next;
+    job_process_t *proc = find_pid(job_list, pid);
+    if (proc == NULL) {
+        return -1;
     }
 
-    return -1;
+    job_element_t *job = proc->job;
+    if (proc->running) {
+        close_pidfd(job_list, proc);
+        job->num_running--;
+        if (usage != NULL) {
+            add_usage(&job->usage, usage);
+        }
+    }
+    if (proc == job->last) {
+        job->status = status;
+    }
+
+    return job->num_running;
 }
 
-/* removes job from list, given job's PID, 
+/* removes job from list, given job's JID,
     returns 0 on success, -1 on failure */
-int remove_job_pid(job_list_t *job_list, pid_t pid) {
+int remove_job_jid(job_list_t *job_list, int jid) {
     if (job_list == NULL) {
         return -1;
     }
 
-    job_element_t *prev = NULL;
-    job_element_t *cur = job_list->head;
-    while (cur != NULL) {
-        if (cur->pid == pid) {
-            if (prev != NULL) {
-                prev->next = cur->next;
-            }
-            if (job_list->head == cur) {
-                job_list->head = cur->next;
-            }
-            if (job_list->current == cur) {
-                job_list->current = cur->next;
-            }
+    job_element_t *cur = find_jid(job_list, jid);
+    if (cur == NULL) {
+        return -1;
+    }
 
-            // free char*'s
-            if (cur->state != NULL) {
-                free(cur->state);
-                cur->state = NULL;
-            }
-            if (cur->command != NULL) {
-                free(cur->command);
-                cur->command = NULL;
-            }
-            free(cur);
-            cur = NULL;
+    remove_element(job_list, cur);
+    return 0;
+}
 
-            return 0;
-        }
+/* removes job from list, given job's PID,
+    returns 0 on success, -1 on failure */
+int remove_job_pid(job_list_t *job_list, pid_t pid) {
+    if (job_list == NULL) {
+        return -1;
+    }
 
-        prev = cur;
-        cur = cur->next;
+    job_process_t *cur = find_pid(job_list, pid);
+    if (cur == NULL) {
+        return -1;
     }
 
-    return -1;
+    remove_element(job_list, cur->job);
+    return 0;
 }
 
 /* updates job's state, given job's JID, returns 0 on success, -1 on failure */
 int update_job_jid(job_list_t *job_list, int jid, process_state_t state) {
-    if (job_list == NULL) {
+    if (job_list == NULL || !valid_state(state)) {
         return -1;
     }
 
-    job_element_t *cur = job_list->head;
-    while (cur != NULL) {
-        if (cur->jid == jid) {
-            // free char * and allocate new char * to protect our code
-            if (cur->state != NULL) {
-                free(cur->state);
-                cur->state = NULL;
-            }
-            cur->state = (char *) malloc(sizeof(char) * (strlen(state) + 1));
-            memcpy(cur->state, state, strlen(state) + 1);
-            return 0;
-        }
-
-        cur = cur->next;
+    job_element_t *cur = find_jid(job_list, jid);
+    if (cur == NULL) {
+        return -1;
     }
 
-    return -1;
+    cur->state = state;
+    return 0;
 }
 
 /* updates job's state, given job's PID, returns 0 on success, -1 on failure */
 int update_job_pid(job_list_t *job_list, pid_t pid, process_state_t state) {
-    if (job_list == NULL) {
+    if (job_list == NULL || !valid_state(state)) {
         return -1;
     }
 
-    job_element_t *cur = job_list->head;
-    while (cur != NULL) {
-        if (cur->pid == pid) {
-            // free char * and allocate new char * to protect our code
-            if (cur->state != NULL) {
-                free(cur->state);
-                cur->state = NULL;
-            }
-            cur->state = (char *) malloc(sizeof(char) * (strlen(state) + 1));
-            memcpy(cur->state, state, strlen(state) + 1);
-            return 0;
-        }
-
-        cur = cur->next;
+    job_process_t *cur = find_pid(job_list, pid);
+    if (cur == NULL) {
+        return -1;
     }
 
-    return -1;
+    cur->job->state = state;
+    return 0;
 }
 
 /* gets PID of job, given job's JID, returns PID on success, -1 on failure */
@@ -256,34 +636,234 @@ pid_t get_job_pid(job_list_t *job_list, int jid) {
         return -1;
     }
 
-    job_element_t *cur = job_list->head;
-    while (cur != NULL) {
-        if (cur->jid == jid) {
-            return cur->pid;
-        }
+    job_element_t *cur = find_jid(job_list, jid);
+    if (cur == NULL) {
+        return -1;
+    }
 
-        cur = cur->next;
+    return cur->pid;
+}
+
+/* gets JID of job, given the PID of any of its processes,
+    returns JID on success, -1 on failure */
+int get_job_jid(job_list_t *job_list, pid_t pid) {
+    if (job_list == NULL) {
+        return -1;
+    }
+
+    job_process_t *cur = find_pid(job_list, pid);
+    if (cur == NULL) {
+        return -1;
+    }
+
+    return cur->job->jid;
+}
+
+/* gets PID of the first of job's processes that is still running, given
+    job's JID, returns PID on success, -1 on failure */
+pid_t get_job_running_pid(job_list_t *job_list, int jid) {
+    if (job_list == NULL) {
+        return -1;
+    }
+
+    job_element_t *cur = find_jid(job_list, jid);
+    if (cur == NULL) {
+        return -1;
+    }
+
+    for (job_process_t *proc = &cur->first; proc != NULL; proc = proc->next) {
+        if (proc->running) {
+            return proc->pid;
+        }
     }
 
     return -1;
 }
 
-/* gets JID of job, given job's PID, returns JID on success, -1 on failure */
-int get_job_jid(job_list_t *job_list, pid_t pid) {
+/* gets state of job, given job's JID, returns state on success,
+    _STATE_NONE on failure */
+process_state_t get_job_state(job_list_t *job_list, int jid) {
+    if (job_list == NULL) {
+        return _STATE_NONE;
+    }
+
+    job_element_t *cur = find_jid(job_list, jid);
+    if (cur == NULL) {
+        return _STATE_NONE;
+    }
+
+    return cur->state;
+}
+
+/* gets the status that the job's last process was reaped with, given job's
+    JID, returns status on success, -1 on failure */
+int get_job_status(job_list_t *job_list, int jid) {
     if (job_list == NULL) {
         return -1;
     }
 
-    job_element_t *cur = job_list->head;
-    while (cur != NULL) {
-        if (cur->pid == pid) {
-            return cur->jid;
+    job_element_t *cur = find_jid(job_list, jid);
+    if (cur == NULL) {
+        return -1;
+    }
+
+    return cur->status;
+}
+
+/* records the CPUs (and NUMA node, -1 if none) a job is placed on, given job's
+    JID, returns 0 on success, -1 on failure */
+int set_job_cpus(job_list_t *job_list, int jid, const cpu_set_t *cpus,
+    int node) {
+    if (job_list == NULL || cpus == NULL) {
+        return -1;
+    }
+
+    job_element_t *cur = find_jid(job_list, jid);
+    if (cur == NULL) {
+        return -1;
+    }
+
+    if (cur->cpus == NULL) {
+        cur->cpus = (cpu_set_t *) malloc(sizeof(cpu_set_t));
+        if (cur->cpus == NULL) {
+            return -1;
         }
+    }
+    *cur->cpus = *cpus;
+    cur->node = node;
+    return 0;
+}
 
-        cur = cur->next;
+/* gets the CPUs a job is placed on, given job's JID, NULL if it isn't placed */
+const cpu_set_t *get_job_cpus(job_list_t *job_list, int jid) {
+    if (job_list == NULL) {
+        return NULL;
     }
 
-    return -1;
+    job_element_t *cur = find_jid(job_list, jid);
+    return cur == NULL ? NULL : cur->cpus;
+}
+
+/* gets the resource usage of the job's processes reaped so far, given job's
+    JID, returns 0 on success, -1 on failure */
+int get_job_usage(job_list_t *job_list, int jid, struct rusage *usage) {
+    if (job_list == NULL || usage == NULL) {
+        return -1;
+    }
+
+    job_element_t *cur = find_jid(job_list, jid);
+    if (cur == NULL) {
+        return -1;
+    }
+
+    *usage = cur->usage;
+    return 0;
+}
+
+/* gets pidfd of a job's process, given its PID,
+    returns pidfd on success, -1 on failure */
+int get_process_pidfd(job_list_t *job_list, pid_t pid) {
+    if (job_list == NULL) {
+        return -1;
+    }
+
+    job_process_t *cur = find_pid(job_list, pid);
+    if (cur == NULL) {
+        return -1;
+    }
+
+    return cur->pidfd;
+}
+
+/*
+ * gets the epoll fd that every running process's pidfd is registered on,
+ * it becomes readable when one of them exits
+ * returns the fd on success, -1 if there is none
+ */
+int get_job_epoll_fd(job_list_t *job_list) {
+    if (job_list == NULL) {
+        return -1;
+    }
+
+    return job_list->epoll_fd;
+}
+
+/*
+ * gets PID of a job's process that has exited, without blocking
+ * the process keeps being returned until it is reaped with reap_job_process()
+ * returns the PID if there is one, -1 if no process with a pidfd has exited
+ */
+pid_t get_exited_pid(job_list_t *job_list) {
+    if (job_list == NULL || job_list->epoll_fd == -1) {
+        return -1;
+    }
+
+    struct epoll_event event;
+    if (epoll_wait(job_list->epoll_fd, &event, 1, 0) != 1) {
+        return -1;
+    }
+
+    return (pid_t) event.data.u64;
+}
+
+/* returns 1 if some running process has no pidfd, so its exit must be found
+    some other way, 0 else */
+int has_untracked_jobs(job_list_t *job_list) {
+    if (job_list == NULL) {
+        return 0;
+    }
+
+    return job_list->num_untracked > 0 || job_list->epoll_fd == -1;
+}
+
+/* gets the number of jobs in the list, returns 0 if job_list is NULL */
+int get_num_jobs(job_list_t *job_list) {
+    if (job_list == NULL) {
+        return 0;
+    }
+
+    return (int) job_list->num_jobs;
+}
+
+/*
+ * sends sig to job's process group, given job's JID, through its pidfd
+ * so the signal can't reach a process that reused the job's PID
+ * returns 0 on success, -1 on failure
+ */
+int signal_job(job_list_t *job_list, int jid, int sig) {
+    if (job_list == NULL) {
+        return -1;
+    }
+
+    job_element_t *cur = find_jid(job_list, jid);
+    if (cur == NULL) {
+        errno = ESRCH;
+        return -1;
+    }
+
+    // any process of the job that is still running can stand in for the
+    // group, as the first one may have exited already
+    job_process_t *proc = &cur->first;
+    while (proc != NULL && proc->pidfd == -1) {
+        proc = proc->next;
+    }
+    if (proc != NULL) {
+        if (pidfd_send_signal(proc->pidfd, sig, NULL,
+                PIDFD_SIGNAL_PROCESS_GROUP) == 0) {
+            return 0;
+        }
+        if (errno != EINVAL) {
+            return -1;
+        }
+        // kernels before 6.9 can only signal one process through a pidfd,
+        // which still tells us the group has not been reaped
+        if (pidfd_send_signal(proc->pidfd, 0, NULL, 0) < 0) {
+            return -1;
+        }
+    }
+
+    // the group's ID can't be reused while any process is left in it
+    return kill(-cur->pid, sig);
 }
 
 /*
@@ -307,6 +887,58 @@ pid_t get_next_pid(job_list_t *job_list) {      // circular iterator
     }
 }
 
+/*
+ * reads a running process's CPU time and resident set size (in KiB) from
+ * /proc/<pid>/stat, returns 0 on success, -1 on failure
+ */
+static int sample_process(pid_t pid, struct timeval *utime,
+    struct timeval *stime, long *rss) {
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int) pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+    char buf[1024];
+    ssize_t len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0) {
+        return -1;
+    }
+    buf[len] = '\0';
+
+    // the command (field 2) may hold spaces and parentheses, so the fields
+    // are counted from the last ')', which is followed by field 3
+    char *field = strrchr(buf, ')');
+    if (field == NULL) {
+        return -1;
+    }
+    unsigned long ticks[2] = {0, 0};
+    long pages = 0;
+    field++;
+    for (int i = 3; i <= 24; i++) {
+        field = strchr(field, ' ');
+        if (field == NULL) {
+            return -1;
+        }
+        field++;
+        if (i == 14 || i == 15) {
+            ticks[i - 14] = strtoul(field, NULL, 10);
+        } else if (i == 24) {
+            pages = strtol(field, NULL, 10);
+        }
+    }
+
+    // times are in clock ticks and the resident set in pages
+    unsigned long hz = (unsigned long) sysconf(_SC_CLK_TCK);
+    utime->tv_sec = (time_t) (ticks[0] / hz);
+    utime->tv_usec = (suseconds_t) (ticks[0] % hz * 1000000 / hz);
+    stime->tv_sec = (time_t) (ticks[1] / hz);
+    stime->tv_usec = (suseconds_t) (ticks[1] % hz * 1000000 / hz);
+    *rss = pages * (sysconf(_SC_PAGESIZE) / 1024);
+    return 0;
+}
+
 /* jobs command, prints out the jobs list */
 void jobs(job_list_t *job_list) {
     if (job_list == NULL) {
@@ -316,7 +948,7 @@ void jobs(job_list_t *job_list) {
     job_element_t *cur = job_list->head;
     while (cur != NULL) {
         if (printf("[%d] (%d) %s %s\n",
-                cur->jid, cur->pid, cur->state, cur->command) < 0) {
+                cur->jid, cur->pid, state_names[cur->state], cur->command) < 0) {
             perror("printf");
             cleanup_job_list(job_list);
             exit(1);
@@ -324,3 +956,93 @@ void jobs(job_list_t *job_list) {
         cur = cur->next;
     }
 }
+
+/*
+ * prints the line of jobs -l with the CPUs a job was placed on, as ranges
+ * (e.g. "0-3,6"), and its NUMA node if it has one
+ */
+static void print_cpus(const cpu_set_t *cpus, int node) {
+    printf("    cpus ");
+    const char *separator = "";
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET((size_t) cpu, cpus)) {
+            continue;
+        }
+        int last = cpu;
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET((size_t) last + 1, cpus)) {
+            last++;
+        }
+        if (last == cpu) {
+            printf("%s%d", separator, cpu);
+        } else {
+            printf("%s%d-%d", separator, cpu, last);
+        }
+        separator = ",";
+        cpu = last;
+    }
+    if (node != -1) {
+        printf(", node %d", node);
+    }
+    printf("\n");
+}
+
+/*
+ * jobs -l command, prints out the jobs list with each job's start time,
+ * elapsed time, CPU time and peak resident set, counting the processes
+ * reaped so far (from wait4) and sampling the running ones from /proc
+ */
+void jobs_long(job_list_t *job_list) {
+    if (job_list == NULL) {
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    job_element_t *cur = job_list->head;
+    while (cur != NULL) {
+        struct timeval utime = cur->usage.ru_utime;
+        struct timeval stime = cur->usage.ru_stime;
+        int num_processes = 0;
+        for (job_process_t *proc = &cur->first; proc != NULL; proc = proc->next) {
+            num_processes++;
+            struct timeval proc_utime, proc_stime;
+            long rss;
+            if (proc->running
+                    && sample_process(proc->pid, &proc_utime, &proc_stime, &rss) == 0) {
+                timeradd(&utime, &proc_utime, &utime);
+                timeradd(&stime, &proc_stime, &stime);
+                if (rss > cur->peak_rss) {
+                    cur->peak_rss = rss;
+                }
+            }
+        }
+        long peak_rss = cur->usage.ru_maxrss > cur->peak_rss
+            ? cur->usage.ru_maxrss : cur->peak_rss;
+        struct timeval cpu;
+        timeradd(&utime, &stime, &cpu);
+        double elapsed = (double) (now.tv_sec - cur->started.tv_sec)
+            + (double) (now.tv_nsec - cur->started.tv_nsec) / 1e9;
+        char started[16];
+        struct tm tm;
+        strftime(started, sizeof(started), "%H:%M:%S",
+            localtime_r(&cur->started_at, &tm));
+
+        if (printf("[%d] (%d) %s %s\n"
+                "    started %s, elapsed %.1fs, cpu %ld.%02lds "
+                "(user %ld.%02lds, sys %ld.%02lds), peak rss %ld KiB, "
+                "%d/%d processes running\n",
+                cur->jid, cur->pid, state_names[cur->state], cur->command,
+                started, elapsed, (long) cpu.tv_sec, (long) cpu.tv_usec / 10000,
+                (long) utime.tv_sec, (long) utime.tv_usec / 10000,
+                (long) stime.tv_sec, (long) stime.tv_usec / 10000, peak_rss,
+                cur->num_running, num_processes) < 0) {
+            perror("printf");
+            cleanup_job_list(job_list);
+            exit(1);
+        }
+        if (cur->cpus != NULL) {
+            print_cpus(cur->cpus, cur->node);
+        }
+        cur = cur->next;
+    }
+}
@@ -2,13 +2,19 @@
 #define JOBS_H_
 
 #include <unistd.h>
+#include <sched.h>
 #include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
 
-#define _STATE_RUNNING "Running"
-#define _STATE_STOPPED "Stopped"
+/* the states a job can be in, _STATE_NONE is only returned on failure */
+typedef enum process_state {
+    _STATE_NONE = -1,
+    _STATE_RUNNING,
+    _STATE_STOPPED
+} process_state_t;
 
 typedef struct job_list job_list_t;
-typedef char *process_state_t;
 
 /* initializes job list, returns pointer */
 job_list_t *init_job_list();
@@ -22,6 +28,20 @@ void cleanup_job_list(job_list_t *job_list);
 /* adds new job to list, returns 0 on success, -1 on failure */
 int add_job(job_list_t *job_list, int jid, pid_t pid, 
 	process_state_t state, char *command);
+/*
+ * adds another process to a job, given job's JID, e.g. a later stage of a
+ * pipeline, which must be in the job's process group
+ * returns 0 on success, -1 on failure
+ */
+int add_job_process(job_list_t *job_list, int jid, pid_t pid);
+/*
+ * marks one of a job's processes as reaped, given its PID, remembering status
+ * (as from waitpid) if it is the job's last process, i.e. its last stage, and
+ * adding usage (as from wait4, NULL if unknown) to the job's resource usage
+ * returns the number of the job's processes still running, -1 on failure
+ */
+int reap_job_process(job_list_t *job_list, pid_t pid, int status,
+	const struct rusage *usage);
 
 /* removes job from list, given job's JID, 
 	returns 0 on success, -1 on failure */
@@ -37,8 +57,59 @@ int update_job_pid(job_list_t *job_list, pid_t pid, process_state_t state);
 
 /* gets PID of job, given job's JID, returns PID on success, -1 on failure */
 pid_t get_job_pid(job_list_t *job_list, int jid);
-/* gets JID of job, given job's PID, returns JID on success, -1 on failure */
+/* gets JID of job, given the PID of any of its processes, 
+	returns JID on success, -1 on failure */
 int get_job_jid(job_list_t *job_list, pid_t pid);
+/* gets PID of the first of job's processes that is still running, given 
+	job's JID, returns PID on success, -1 on failure */
+pid_t get_job_running_pid(job_list_t *job_list, int jid);
+/* gets state of job, given job's JID, returns state on success, 
+	_STATE_NONE on failure */
+process_state_t get_job_state(job_list_t *job_list, int jid);
+/* gets the status that the job's last process was reaped with, given job's 
+	JID, returns status on success, -1 on failure */
+int get_job_status(job_list_t *job_list, int jid);
+/* gets the resource usage of the job's processes reaped so far (times and 
+	counts summed, ru_maxrss the largest), given job's JID, 
+	returns 0 on success, -1 on failure */
+int get_job_usage(job_list_t *job_list, int jid, struct rusage *usage);
+/* records the CPUs a job was placed on (copied) and the NUMA node its memory 
+	is preferred on (-1 for none), given job's JID, 
+	returns 0 on success, -1 on failure */
+int set_job_cpus(job_list_t *job_list, int jid, const cpu_set_t *cpus, 
+	int node);
+/* gets the CPUs a job was placed on, given job's JID, 
+	returns them on success, NULL if it was not placed or on failure */
+const cpu_set_t *get_job_cpus(job_list_t *job_list, int jid);
+
+/* gets pidfd of a job's process, given its PID, 
+	returns pidfd on success, -1 on failure */
+int get_process_pidfd(job_list_t *job_list, pid_t pid);
+
+/*
+ * gets the epoll fd that every running process's pidfd is registered on,
+ * it becomes readable when one of them exits
+ * returns the fd on success, -1 if there is none
+ */
+int get_job_epoll_fd(job_list_t *job_list);
+/*
+ * gets PID of a job's process that has exited, without blocking
+ * the process keeps being returned until it is reaped with reap_job_process()
+ * returns the PID if there is one, -1 if no process with a pidfd has exited
+ */
+pid_t get_exited_pid(job_list_t *job_list);
+/* returns 1 if some running process has no pidfd, so its exit must be found 
+	some other way, 0 else */
+int has_untracked_jobs(job_list_t *job_list);
+/* gets the number of jobs in the list */
+int get_num_jobs(job_list_t *job_list);
+
+/*
+ * sends sig to job's process group, given job's JID, through its pidfd
+ * so the signal can't reach a process that reused the job's PID
+ * returns 0 on success, -1 on failure
+ */
+int signal_job(job_list_t *job_list, int jid, int sig);
 
 /* 
  * gets next PID in list
@@ -50,5 +121,9 @@ pid_t get_next_pid(job_list_t *job_list);
 
 /* jobs command, prints out the jobs list */
 void jobs(job_list_t *job_list);
+/* jobs -l command, prints out the jobs list with each job's start time, 
+	elapsed time, CPU time and peak resident set, sampling running 
+	processes from /proc/<pid>/stat, and the CPUs it was placed on */
+void jobs_long(job_list_t *job_list);
 
 #endif  // JOBS_H_
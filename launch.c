@@ -0,0 +1,385 @@
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include "launch.h"
+#include "zygote.h"
+#include "trace.h"
+
+/* posix_spawn_file_actions_addtcsetpgrp_np() first appeared in glibc 2.35 */
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 35)
+#define SPAWN_TCSETPGRP 1
+#endif
+
+/* capacity given to new pipes, 0 leaves the system default (usually 64 KiB) */
+static int pipe_size = 0;
+
+/*
+ * set_node_policy() - makes the calling process prefer a NUMA node for its memory from now on,
+ *                     inherited by its children like the CPU affinity (glibc has no wrapper for
+ *                     set_mempolicy(), and libnuma is not needed for this much)
+ *
+ * Parameters:
+ *  - node: the node, -1 to go back to the default policy (the local node)
+ *
+ * Returns:
+ *	- 0 on success, -1 with errno set on failure (ENOSYS on a kernel without NUMA)
+ */
+int set_node_policy(int node){
+  if (node == -1){
+    return (int) syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+  }
+  unsigned long mask[16] = {0};
+  size_t bits = sizeof(mask[0]) * 8;
+  if (node < 0 || (size_t) node >= bits * 16){
+    errno = EINVAL;
+    return -1;
+  }
+  mask[(size_t) node / bits] = 1UL << ((size_t) node % bits);
+  return (int) syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, bits * 16);
+}
+
+/*
+ * spawn_setup() - fills in the spawn attributes and file actions that describe the child setup
+ *                 which fork_child() performs by hand
+ *
+ * Parameters:
+ *  - launch: a launch_t* describing the child
+ *  - attr: the posix_spawnattr_t* to initialize
+ *  - actions: the posix_spawn_file_actions_t* to initialize
+ *
+ * Returns:
+ *	- 0 on success, or an error number if the attributes could not be built (both structures are
+ *    destroyed again in that case)
+ */
+static int spawn_setup(launch_t *launch, posix_spawnattr_t *attr,
+  posix_spawn_file_actions_t *actions){
+  int err;
+  if ((err = posix_spawnattr_init(attr)) != 0){
+    return err;
+  }
+  if ((err = posix_spawn_file_actions_init(actions)) != 0){
+    posix_spawnattr_destroy(attr);
+    return err;
+  }
+  /* its process group, the signals the shell may ignore back to default, nothing blocked */
+  sigset_t sig_default, sig_mask;
+  sigemptyset(&sig_default);
+  sigaddset(&sig_default, SIGINT);
+  sigaddset(&sig_default, SIGTSTP);
+  sigaddset(&sig_default, SIGQUIT);
+  sigaddset(&sig_default, SIGTTOU);
+  sigaddset(&sig_default, SIGPIPE);
+  sigemptyset(&sig_mask);
+  short flags = POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+  if ((err = posix_spawnattr_setflags(attr, flags)) != 0
+      || (err = posix_spawnattr_setpgroup(attr, launch->pgid)) != 0
+      || (err = posix_spawnattr_setsigdefault(attr, &sig_default)) != 0
+      || (err = posix_spawnattr_setsigmask(attr, &sig_mask)) != 0){
+    goto fail;
+  }
+  /* the terminal is handed over after setpgid() and before the redirections, as in fork_child() */
+  if (launch->foreground){
+#ifdef SPAWN_TCSETPGRP
+    if ((err = posix_spawn_file_actions_addtcsetpgrp_np(actions, STDIN_FILENO)) != 0){
+      goto fail;
+    }
+#else
+    err = ENOSYS;
+    goto fail;
+#endif
+  }
+  /* pipe ends first, so redirection files take precedence over them */
+  if (launch->in_fd != -1){
+    if ((err = posix_spawn_file_actions_adddup2(actions, launch->in_fd, STDIN_FILENO)) != 0){
+      goto fail;
+    }
+  }
+  if (launch->out_fd != -1){
+    if ((err = posix_spawn_file_actions_adddup2(actions, launch->out_fd, STDOUT_FILENO)) != 0){
+      goto fail;
+    }
+  }
+  if (launch->input != NULL){
+    if ((err = posix_spawn_file_actions_addopen(actions, STDIN_FILENO, launch->input,
+        O_RDONLY, 0)) != 0){
+      goto fail;
+    }
+  }
+  if (launch->output != NULL){
+    int options = O_WRONLY | O_CREAT | (launch->append ? O_APPEND : O_TRUNC);
+    if ((err = posix_spawn_file_actions_addopen(actions, STDOUT_FILENO, launch->output,
+        options, 0666)) != 0){
+      goto fail;
+    }
+  }
+  return 0;
+fail:
+  posix_spawn_file_actions_destroy(actions);
+  posix_spawnattr_destroy(attr);
+  return err;
+}
+
+/*
+ * spawn_launch() - launches the child with posix_spawn(), which on glibc is a clone(CLONE_VM |
+ *                  CLONE_VFORK), so the cost does not grow with the shell's memory footprint
+ *
+ * Parameters:
+ *  - launch: a launch_t* describing the child
+ *  - setup_failed: an int* set to 1 if the spawn attributes could not be built, 0 else
+ *
+ * Returns:
+ *	- the pid of the child, or -1 with errno set if it could not be started (including a failed
+ *    exec, which posix_spawn() reports back to the parent)
+ */
+static pid_t spawn_launch(launch_t *launch, int *setup_failed){
+  posix_spawnattr_t attr;
+  posix_spawn_file_actions_t actions;
+  int err = spawn_setup(launch, &attr, &actions);
+  *setup_failed = (err != 0);
+  if (err != 0){
+    errno = err;
+    return -1;
+  }
+  /* posix_spawn() only returns once the child has exec'd (or failed to), so the span covers
+     the whole launch */
+  double start = TRACE_ON ? trace_now() : 0;
+  /* there is no spawn attribute for the CPU affinity or memory policy, but the child inherits
+     both from the shell when it is cloned, before it execs, so the shell takes them on for the
+     length of the call (a placement the kernel refuses leaves the child with the shell's own) */
+  cpu_set_t shell_cpus;
+  int placed = launch->cpus != NULL
+    && sched_getaffinity(0, sizeof(shell_cpus), &shell_cpus) == 0
+    && sched_setaffinity(0, sizeof(cpu_set_t), launch->cpus) == 0;
+  int node_set = launch->node != -1 && set_node_policy(launch->node) == 0;
+  pid_t pid_child;
+  err = posix_spawn(&pid_child, launch->path, &actions, &attr, launch->argv, environ);
+  if (placed){
+    sched_setaffinity(0, sizeof(shell_cpus), &shell_cpus);
+  }
+  if (node_set){
+    set_node_policy(-1);
+  }
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attr);
+  if (err != 0){
+    if (TRACE_ON){
+      trace_span("spawn", start, 0, launch->path);
+    }
+    errno = err;
+    return -1;
+  }
+  if (TRACE_ON){
+    trace_span("spawn", start, pid_child, launch->path);
+    if (launch->foreground){
+      trace_instant("tcsetpgrp", launch->pgid ? launch->pgid : pid_child, "child");
+    }
+  }
+  return pid_child;
+}
+
+/* same as launch_child(), but always uses posix_spawn() */
+pid_t spawn_child(launch_t *launch){
+  int setup_failed;
+  return spawn_launch(launch, &setup_failed);
+}
+
+/*
+ * fork_child() - launches the child with fork(), making the setup system calls in the child
+ *                before calling execv()
+ *
+ * Parameters:
+ *  - launch: a launch_t* describing the child
+ *
+ * Returns:
+ *	- the pid of the child, or -1 with errno set if fork() failed (a failed exec is reported by
+ *    the child, which then exits with status 1)
+ */
+pid_t fork_child(launch_t *launch){
+  double start = TRACE_ON ? trace_now() : 0;
+  pid_t pid_child = fork();
+  if (pid_child == -1){
+    return -1;
+  }
+  if (pid_child == 0){
+    if (TRACE_ON){
+      trace_span("fork", start, getpid(), "child");
+    }
+    /* joins the process group (its own if pgid is 0), transfer control if not
+       a background process */
+    if (setpgid(0, launch->pgid) == -1){
+      perror("setpgid");
+      _exit(1);
+    }
+    if (launch->foreground){
+      if (tcsetpgrp(STDIN_FILENO, getpgrp()) == -1){
+        perror("tcsetpgrp");
+        _exit(1);
+      }
+      if (TRACE_ON){
+        trace_instant("tcsetpgrp", getpgrp(), "child");
+      }
+    }
+    /* sets the signal ignores back to default handling in the child */
+    if (signal(SIGINT, SIG_DFL) == SIG_ERR || signal(SIGTSTP, SIG_DFL) == SIG_ERR
+        || signal(SIGQUIT, SIG_DFL) == SIG_ERR || signal(SIGTTOU, SIG_DFL) == SIG_ERR
+        || signal(SIGPIPE, SIG_DFL) == SIG_ERR){
+      perror("signal");
+      _exit(1);
+    }
+    sigset_t sig_mask;
+    sigemptyset(&sig_mask);
+    if (sigprocmask(SIG_SETMASK, &sig_mask, NULL) == -1){
+      perror("sigprocmask");
+      _exit(1);
+    }
+    /* its CPUs and memory node, a placement the kernel refuses leaves it with the shell's own */
+    if (launch->cpus != NULL && sched_setaffinity(0, sizeof(cpu_set_t), launch->cpus) == -1){
+      perror("sched_setaffinity");
+    }
+    if (launch->node != -1){
+      set_node_policy(launch->node);
+    }
+    /* moves the pipe ends onto standard input and output, the others are close-on-exec */
+    if (launch->in_fd != -1 && dup2(launch->in_fd, STDIN_FILENO) == -1){
+      perror("dup2");
+      _exit(1);
+    }
+    if (launch->out_fd != -1 && dup2(launch->out_fd, STDOUT_FILENO) == -1){
+      perror("dup2");
+      _exit(1);
+    }
+    /* checks if "<" used, handles appropriately */
+    if (launch->input != NULL){
+      if (close(STDIN_FILENO) == -1){
+        perror("close");
+        _exit(1);
+      }
+      if (open(launch->input, O_RDONLY) == -1){
+        perror("open");
+        _exit(1);
+      }
+    }
+    /* checks if ">" or ">>" used, handles appropriately */
+    if (launch->output != NULL){
+      if (close(STDOUT_FILENO) == -1){
+        perror("close");
+        _exit(1);
+      }
+      int options = O_WRONLY | O_CREAT | (launch->append ? O_APPEND : O_TRUNC);
+      if (open(launch->output, options, 0666) == -1){
+        perror("open");
+        _exit(1);
+      }
+    }
+    /* executes child process replacing old stack */
+    if (TRACE_ON){
+      trace_instant("child_ready", getpid(), launch->path);
+    }
+    execv(launch->path, launch->argv);
+    /* we won't get here unless execv failed */
+    perror("execv");
+    _exit(1);
+  }
+  /* also set the group from the parent, so it exists before we signal or wait on it */
+  setpgid(pid_child, launch->pgid ? launch->pgid : pid_child);
+  if (TRACE_ON){
+    trace_span("fork", start, pid_child, launch->path);
+  }
+  return pid_child;
+}
+
+/*
+ * launch_child() - launches the child through the zygote if one is running, or else with
+ *                  posix_spawn(), falling back to fork() when the shell is built with
+ *                  -DFORK_LAUNCH or the spawn attributes are not supported
+ *
+ * Parameters:
+ *  - launch: a launch_t* describing the child
+ *
+ * Returns:
+ *	- the pid of the child, or -1 with errno set if it could not be started
+ */
+pid_t launch_child(launch_t *launch){
+  if (zygote_running()){
+    int unavailable;
+    pid_t pid_child = zygote_child(launch, &unavailable);
+    if (!unavailable){
+      return pid_child;
+    }
+  }
+#ifdef FORK_LAUNCH
+  return fork_child(launch);
+#else
+  int setup_failed;
+  pid_t pid_child = spawn_launch(launch, &setup_failed);
+  if (pid_child == -1 && setup_failed){
+    return fork_child(launch);
+  }
+  return pid_child;
+#endif
+}
+
+/*
+ * open_pipe() - opens a pipe for a pipeline, with both ends close-on-exec so a child only keeps the
+ *               ends it is given, and with the capacity set by set_pipe_size() if there is one
+ *
+ * Parameters:
+ *  - fds: an int array of two, set to the read and write ends
+ *
+ * Returns:
+ *	- 0 on success, -1 on failure with errno set (a capacity the kernel refuses is not a failure,
+ *    the pipe just keeps the default)
+ */
+int open_pipe(int fds[2]){
+  if (pipe2(fds, O_CLOEXEC) == -1){
+    return -1;
+  }
+  if (pipe_size > 0){
+    fcntl(fds[1], F_SETPIPE_SZ, pipe_size);
+  }
+  return 0;
+}
+
+/*
+ * set_pipe_size() - sets the capacity of the pipes opened by open_pipe() from now on, trying it on
+ *                   a scratch pipe first so that a size the kernel refuses is reported right away
+ *
+ * Parameters:
+ *  - size: the capacity in bytes, 0 for the system default
+ *
+ * Returns:
+ *	- the capacity the kernel actually uses (it rounds up to a power of two number of pages), or
+ *    -1 with errno set if it was refused (e.g. over /proc/sys/fs/pipe-max-size)
+ */
+int set_pipe_size(int size){
+  if (size == 0){
+    pipe_size = 0;
+    return 0;
+  }
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC) == -1){
+    return -1;
+  }
+  int actual = fcntl(fds[1], F_SETPIPE_SZ, size);
+  int saved_errno = errno;
+  close(fds[0]);
+  close(fds[1]);
+  if (actual == -1){
+    errno = saved_errno;
+    return -1;
+  }
+  pipe_size = actual;
+  return actual;
+}
+
+/* gets the capacity set by set_pipe_size(), 0 if it is the system default */
+int get_pipe_size(){
+  return pipe_size;
+}
@@ -0,0 +1,60 @@
+#ifndef LAUNCH_H_
+#define LAUNCH_H_
+
+#include <unistd.h>
+#include <sched.h>
+#include <sys/types.h>
+
+/*
+ * describes one child to launch, in_fd and out_fd are pipe ends to use as its standard input and
+ * output (-1 for none), a NULL input or output file overrides them, pgid is the process group
+ * to join, 0 for a new one led by the child, cpus the CPUs it may run on (NULL for the shell's
+ * own) and node the NUMA node its memory is preferred on (-1 for none)
+ */
+typedef struct launch {
+  const char *path;
+  char **argv;
+  char *input;
+  char *output;
+  int append;
+  int in_fd;
+  int out_fd;
+  pid_t pgid;
+  int foreground;
+  const cpu_set_t *cpus;
+  int node;
+} launch_t;
+
+/*
+ * launches the child in its process group (see launch_t) with the shell's ignored signals
+ * reset to default, redirections opened, its CPUs and memory node set, and, if foreground, the
+ * terminal handed to it, through the zygote if one is running (see zygote.h), returns the
+ * child's pid on success, -1 on failure with errno set
+ */
+pid_t launch_child(launch_t *launch);
+
+/* same as launch_child(), but always uses posix_spawn() */
+pid_t spawn_child(launch_t *launch);
+
+/* same as launch_child(), but always uses fork() and sets the child up by hand */
+pid_t fork_child(launch_t *launch);
+
+/* makes the calling process prefer a NUMA node for its memory from now on (-1 for the default
+   policy), returns 0 on success, -1 on failure with errno set */
+int set_node_policy(int node);
+
+/*
+ * opens a pipe for a pipeline with both ends close-on-exec, so a child only keeps the ends it
+ * is given, and with the capacity set by set_pipe_size() if there is one
+ * returns 0 on success, -1 on failure with errno set
+ */
+int open_pipe(int fds[2]);
+
+/* sets the capacity of pipes opened from now on, 0 for the system default, returns the size
+   the kernel actually uses (it rounds up to a power of two pages), -1 on failure */
+int set_pipe_size(int size);
+
+/* gets the capacity set by set_pipe_size(), 0 if it is the system default */
+int get_pipe_size();
+
+#endif  // LAUNCH_H_
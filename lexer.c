@@ -0,0 +1,254 @@
+#include <string.h>
+#include <errno.h>
+#include "lexer.h"
+
+/* initial number of tokens a list has room for */
+#define LEX_INITIAL_TOKENS 32
+
+/* character classes, anything that is not LEX_PLAIN ends a run of plain characters */
+enum {
+  LEX_PLAIN = 0,
+  LEX_END,
+  LEX_BLANK,
+  LEX_OPERATOR,
+  LEX_SINGLE_QUOTE,
+  LEX_DOUBLE_QUOTE,
+  LEX_BACKSLASH,
+  LEX_GLOB
+};
+
+/* class of each byte, so a run of plain characters is scanned with one load and test each */
+static const unsigned char lex_class[256] = {
+  ['\0'] = LEX_END,
+  [' '] = LEX_BLANK,
+  ['\t'] = LEX_BLANK,
+  ['\n'] = LEX_BLANK,
+  ['|'] = LEX_OPERATOR,
+  ['<'] = LEX_OPERATOR,
+  ['>'] = LEX_OPERATOR,
+  ['&'] = LEX_OPERATOR,
+  [';'] = LEX_OPERATOR,
+  ['\''] = LEX_SINGLE_QUOTE,
+  ['"'] = LEX_DOUBLE_QUOTE,
+  ['\\'] = LEX_BACKSLASH,
+  ['*'] = LEX_GLOB,
+  ['?'] = LEX_GLOB,
+  ['['] = LEX_GLOB
+};
+
+void init_token_list(token_list_t *list, arena_t *arena){
+  list->tokens = NULL;
+  list->num_tokens = 0;
+  list->capacity = 0;
+  list->arena = arena;
+}
+
+/* appends a token, doubling the array when it is full (in place, unless a pattern was allocated
+   from the arena since), returns 0 on success, -1 on failure */
+static int push_token(token_list_t *list, token_type_t type, char *text, char *pattern){
+  if (list->num_tokens == list->capacity){
+    size_t capacity = list->capacity ? list->capacity * 2 : LEX_INITIAL_TOKENS;
+    token_t *tokens = (token_t *) arena_grow(list->arena, list->tokens,
+      list->capacity * sizeof(token_t), capacity * sizeof(token_t));
+    if (tokens == NULL){
+      return -1;
+    }
+    list->tokens = tokens;
+    list->capacity = capacity;
+  }
+  list->tokens[list->num_tokens].type = type;
+  list->tokens[list->num_tokens].text = text;
+  list->tokens[list->num_tokens].pattern = pattern;
+  list->num_tokens++;
+  return 0;
+}
+
+/* the characters that mean something in a glob pattern */
+static int is_pattern_char(char c){
+  return c == '*' || c == '?' || c == '[' || c == ']' || c == '\\';
+}
+
+/*
+ * adds the len characters just unquoted at quoted, in the word starting at word, to the word's
+ * pattern, escaping those that mean something in one: the pattern is only begun at the first of
+ * those, with the word so far (nothing in which needs escaping then), and given room for all of
+ * rest, the part of the line still to be scanned, escaped
+ * returns 0 on success, -1 on failure
+ */
+static int add_quoted(token_list_t *list, char **pattern, char **end, const char *word,
+  const char *quoted, size_t len, const char *rest){
+  if (*pattern == NULL){
+    size_t first = 0;
+    while (first < len && !is_pattern_char(quoted[first])){
+      first++;
+    }
+    if (first == len){
+      return 0;
+    }
+    size_t before = (size_t) (quoted - word);
+    *pattern = (char *) arena_alloc(list->arena, before + 2 * (len + strlen(rest)) + 1);
+    if (*pattern == NULL){
+      return -1;
+    }
+    memcpy(*pattern, word, before);
+    *end = *pattern + before;
+  }
+  for (size_t i = 0; i < len; i++){
+    if (is_pattern_char(quoted[i])){
+      *(*end)++ = '\\';
+    }
+    *(*end)++ = quoted[i];
+  }
+  return 0;
+}
+
+int lex_line(token_list_t *list, char *line){
+  list->num_tokens = 0;
+  /* scan is where the line is scanned, and out where the unquoted words are written, which
+     never gets ahead of scan, since unquoting only ever removes characters
+     c is the character at scan, kept aside since the '\0' ending a word may overwrite it */
+  char *scan = line;
+  char *out = line;
+  char c = *scan;
+  while(1){
+    while (lex_class[(unsigned char) c] == LEX_BLANK){
+      c = *++scan;
+    }
+    if (c == '\0'){
+      return 0;
+    }
+    if (lex_class[(unsigned char) c] == LEX_OPERATOR){
+      token_type_t type;
+      if (c == '|' && scan[1] == '|'){
+        type = TOKEN_OR;
+        scan++;
+      } else if (c == '|'){
+        type = TOKEN_PIPE;
+      } else if (c == '<'){
+        type = TOKEN_INPUT;
+      } else if (c == '&' && scan[1] == '&'){
+        type = TOKEN_AND;
+        scan++;
+      } else if (c == '&'){
+        type = TOKEN_BACKGROUND;
+      } else if (c == ';'){
+        type = TOKEN_SEMICOLON;
+      } else if (scan[1] == '>'){
+        type = TOKEN_APPEND;
+        scan++;
+      } else {
+        type = TOKEN_OUTPUT;
+      }
+      if (push_token(list, type, NULL, NULL) == -1){
+        errno = ENOMEM;
+        return -1;
+      }
+      c = *++scan;
+      out = scan;
+      continue;
+    }
+    /* a word, made of runs of plain characters, quoted strings and escapes, up to a blank,
+       an operator or the end of the line */
+    char *word = out;
+    /* glob is set by an unquoted *, ? or [, and pattern is only begun once something quoted
+       would mean something in a pattern, and from then on gets all the word does */
+    int glob = 0;
+    char *pattern = NULL;
+    char *pattern_end = NULL;
+    while(1){
+      /* the run of plain characters is only moved if something was unquoted before it */
+      char *run = scan;
+      while (lex_class[(unsigned char) c] == LEX_PLAIN){
+        c = *++scan;
+      }
+      if (out != run){
+        memmove(out, run, (size_t) (scan - run));
+      }
+      if (pattern != NULL){
+        memcpy(pattern_end, out, (size_t) (scan - run));
+        pattern_end += scan - run;
+      }
+      out += scan - run;
+      unsigned char class = lex_class[(unsigned char) c];
+      if (class == LEX_GLOB){
+        glob = 1;
+        if (pattern != NULL){
+          *pattern_end++ = c;
+        }
+        *out++ = c;
+        c = *++scan;
+      } else if (class == LEX_SINGLE_QUOTE){
+        /* everything up to the closing quote is literal */
+        char *close = strchr(scan + 1, '\'');
+        if (close == NULL){
+          errno = EINVAL;
+          return -1;
+        }
+        size_t len = (size_t) (close - scan - 1);
+        memmove(out, scan + 1, len);
+        scan = close + 1;
+        if (add_quoted(list, &pattern, &pattern_end, word, out, len, scan) == -1){
+          errno = ENOMEM;
+          return -1;
+        }
+        out += len;
+        c = *scan;
+      } else if (class == LEX_DOUBLE_QUOTE){
+        /* a backslash only escapes ", \, $ and ` in double quotes, and is kept otherwise */
+        char *quoted = out;
+        c = *++scan;
+        while (c != '"'){
+          if (c == '\0'){
+            errno = EINVAL;
+            return -1;
+          }
+          if (c == '\\' && (scan[1] == '"' || scan[1] == '\\' || scan[1] == '$'
+              || scan[1] == '`')){
+            c = *++scan;
+          }
+          *out++ = c;
+          c = *++scan;
+        }
+        c = *++scan;
+        if (add_quoted(list, &pattern, &pattern_end, word, quoted, (size_t) (out - quoted),
+            scan) == -1){
+          errno = ENOMEM;
+          return -1;
+        }
+      } else if (class == LEX_BACKSLASH){
+        /* escapes the next character, a backslash at the end of the line is kept as is */
+        if (scan[1] != '\0'){
+          scan++;
+        }
+        *out++ = *scan;
+        c = *++scan;
+        if (add_quoted(list, &pattern, &pattern_end, word, out - 1, 1, scan) == -1){
+          errno = ENOMEM;
+          return -1;
+        }
+      } else {
+        break;
+      }
+    }
+    /* c holds the character that ended the word, so it is safe to overwrite it here */
+    *out++ = '\0';
+    if (pattern != NULL){
+      *pattern_end = '\0';
+    }
+    if (push_token(list, TOKEN_WORD, word, !glob ? NULL : (pattern != NULL ? pattern : word))
+        == -1){
+      errno = ENOMEM;
+      return -1;
+    }
+    if (out <= scan){
+      continue;
+    }
+    /* the '\0' went where c was (nothing had been unquoted), which is fine as c is kept, but
+       out must not be left past scan */
+    out = scan;
+    if (lex_class[(unsigned char) c] == LEX_BLANK){
+      c = *++scan;
+      out = scan;
+    }
+  }
+}
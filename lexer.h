@@ -0,0 +1,51 @@
+#ifndef LEXER_H_
+#define LEXER_H_
+
+#include <stddef.h>
+#include "arena.h"
+
+/* the kinds of tokens, a quoted or escaped operator is just part of a TOKEN_WORD */
+typedef enum token_type {
+  TOKEN_WORD,
+  TOKEN_PIPE,
+  TOKEN_INPUT,
+  TOKEN_OUTPUT,
+  TOKEN_APPEND,
+  TOKEN_BACKGROUND,
+  TOKEN_SEMICOLON,
+  TOKEN_AND,
+  TOKEN_OR
+} token_type_t;
+
+/* text is the unquoted word, in the line itself, and NULL for an operator, pattern is the word
+   as a glob pattern (see glob.h) if it has an unquoted *, ? or [, with whatever was quoted in it
+   escaped, and NULL else */
+typedef struct token {
+  token_type_t type;
+  char *text;
+  char *pattern;
+} token_t;
+
+/* the tokens of a line, the array is allocated from arena and grows as needed */
+typedef struct token_list {
+  token_t *tokens;
+  size_t num_tokens;
+  size_t capacity;
+  arena_t *arena;
+} token_list_t;
+
+/* initializes an empty token list that allocates from arena, it must be initialized again
+   after the arena is reset */
+void init_token_list(token_list_t *list, arena_t *arena);
+
+/*
+ * splits line into tokens in a single pass, on blanks and around the operators |, <, >, >>, &,
+ * ;, && and ||, handling single quotes, double quotes and backslash escapes
+ * the words are unquoted in place and '\0' terminated, so line is modified, and the tokens point
+ * into it, as do their patterns unless something quoted in them has to be escaped, which is
+ * rare enough for those to be allocated from the list's arena
+ * returns 0 on success, -1 on failure with errno set (EINVAL if a quote is not closed)
+ */
+int lex_line(token_list_t *list, char *line);
+
+#endif  // LEXER_H_
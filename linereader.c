@@ -0,0 +1,215 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include "linereader.h"
+
+/* size of each read() when not mapped, the buffer doubles for longer lines */
+#define READ_CHUNK_SIZE 65536
+
+/*
+ * data holds the input from start to end, which is either the mapping of the whole file (then
+ * start and end are file offsets) or buf, where the unread data is moved to the front before
+ * each read()
+ * buf always has room for one more byte after end, for the '\0' of a last line with no newline
+ */
+struct line_reader {
+  int fd;
+  char *data;
+  size_t start;
+  size_t end;
+  char *map;
+  size_t map_len;
+  char *buf;
+  size_t buf_cap;
+  int seekable;
+  int resync;
+  int eof;
+  int socket;
+};
+
+/* stops using the mapping, so reading continues with read() from the fd's offset */
+static void unmap(line_reader_t *reader){
+  munmap(reader->map, reader->map_len);
+  reader->map = NULL;
+  reader->data = reader->buf;
+  reader->start = 0;
+  reader->end = 0;
+}
+
+line_reader_t *init_line_reader(int fd){
+  line_reader_t *reader = (line_reader_t *) calloc(1, sizeof(line_reader_t));
+  if (reader == NULL){
+    return NULL;
+  }
+  reader->fd = fd;
+  reader->buf_cap = READ_CHUNK_SIZE;
+  if ((reader->buf = (char *) malloc(reader->buf_cap)) == NULL){
+    free(reader);
+    return NULL;
+  }
+  reader->data = reader->buf;
+  /* a tty or pipe can't seek, so nothing can be handed back to a child */
+  off_t offset = lseek(fd, 0, SEEK_CUR);
+  reader->seekable = (offset != -1);
+  /* a regular file is mapped (privately, so newlines can become '\0's) instead of read, which
+     makes reading it one mmap() however many lines it has */
+  struct stat st;
+  if (reader->seekable && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > offset){
+    void *map = mmap(NULL, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED){
+      reader->map = (char *) map;
+      reader->map_len = (size_t) st.st_size;
+      reader->data = reader->map;
+      reader->start = (size_t) offset;
+      reader->end = reader->map_len;
+    }
+  }
+  return reader;
+}
+
+line_reader_t *init_socket_reader(int fd){
+  line_reader_t *reader = init_line_reader(fd);
+  if (reader != NULL){
+    reader->socket = 1;
+  }
+  return reader;
+}
+
+void cleanup_line_reader(line_reader_t *reader){
+  if (reader == NULL){
+    return;
+  }
+  if (reader->map != NULL){
+    munmap(reader->map, reader->map_len);
+  }
+  free(reader->buf);
+  free(reader);
+}
+
+char *read_line(line_reader_t *reader, size_t *len){
+  /* a child may have read from the fd since sync_line_reader(), so the mapping picks up from
+     wherever the fd's offset is now */
+  if (reader->resync){
+    reader->resync = 0;
+    off_t offset = lseek(reader->fd, 0, SEEK_CUR);
+    if (offset == -1){
+      return NULL;
+    }
+    if ((size_t) offset <= reader->map_len){
+      reader->start = (size_t) offset;
+    } else {
+      /* past the end of the mapping, so the file grew and it is read from here on */
+      unmap(reader);
+    }
+  }
+  while(1){
+    char *line = reader->data + reader->start;
+    char *newline = (char *) memchr(line, '\n', reader->end - reader->start);
+    if (newline != NULL){
+      *newline = '\0';
+      *len = (size_t) (newline - line);
+      reader->start += *len + 1;
+      return line;
+    }
+    /* the end of the mapping might not be the end of the file (or of the line) if it grew, and
+       the mapping may have no room for a '\0', so the rest is read */
+    if (reader->map != NULL){
+      off_t offset = (off_t) reader->start;
+      unmap(reader);
+      if (lseek(reader->fd, offset, SEEK_SET) == -1){
+        return NULL;
+      }
+      continue;
+    }
+    if (reader->eof){
+      /* a last line with no newline */
+      if (reader->start == reader->end){
+        errno = 0;
+        return NULL;
+      }
+      line[reader->end - reader->start] = '\0';
+      *len = reader->end - reader->start;
+      reader->start = reader->end;
+      return line;
+    }
+    /* moves the partial line to the front, and grows the buffer if it is all one line */
+    if (reader->start > 0){
+      memmove(reader->buf, line, reader->end - reader->start);
+      reader->end -= reader->start;
+      reader->start = 0;
+    }
+    if (reader->buf_cap - reader->end <= 1){
+      char *buf = (char *) realloc(reader->buf, reader->buf_cap * 2);
+      if (buf == NULL){
+        errno = ENOMEM;
+        return NULL;
+      }
+      reader->buf = buf;
+      reader->data = buf;
+      reader->buf_cap *= 2;
+    }
+    /* a socket is read without waiting, its fd stays blocking for the children writing to it */
+    size_t room = reader->buf_cap - reader->end - 1;
+    ssize_t count = reader->socket ? recv(reader->fd, reader->buf + reader->end, room, MSG_DONTWAIT)
+      : read(reader->fd, reader->buf + reader->end, room);
+    if (count == -1){
+      if (errno == EINTR){
+        continue;
+      }
+      return NULL;
+    }
+    if (count == 0){
+      reader->eof = 1;
+    }
+    reader->end += (size_t) count;
+  }
+}
+
+int has_buffered_line(line_reader_t *reader){
+  if (reader->resync){
+    return 0;
+  }
+  if (reader->map != NULL){
+    return reader->start < reader->end;
+  }
+  return reader->eof || memchr(reader->data + reader->start, '\n', reader->end - reader->start);
+}
+
+int sync_line_reader(line_reader_t *reader){
+  if (!reader->seekable){
+    return 0;
+  }
+  if (reader->map != NULL){
+    if (lseek(reader->fd, (off_t) reader->start, SEEK_SET) == -1){
+      return -1;
+    }
+    reader->resync = 1;
+    return 0;
+  }
+  /* the read() buffer is dropped, and filled again from wherever the child leaves the offset */
+  if (lseek(reader->fd, -(off_t) (reader->end - reader->start), SEEK_CUR) == -1){
+    return -1;
+  }
+  reader->start = 0;
+  reader->end = 0;
+  reader->eof = 0;
+  return 0;
+}
+
+char *read_ahead(line_reader_t *reader, size_t *len){
+  *len = reader->end - reader->start;
+  if (reader->seekable || *len == 0){
+    return NULL;
+  }
+  return reader->data + reader->start;
+}
+
+void skip_read_ahead(line_reader_t *reader){
+  if (!reader->seekable){
+    reader->start = reader->end;
+  }
+}
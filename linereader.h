@@ -0,0 +1,55 @@
+#ifndef LINEREADER_H_
+#define LINEREADER_H_
+
+#include <stddef.h>
+
+typedef struct line_reader line_reader_t;
+
+/*
+ * initializes a reader of the lines of fd, which maps fd if it is a regular file and reads it in
+ * large chunks otherwise, returns pointer on success, NULL on failure
+ */
+line_reader_t *init_line_reader(int fd);
+
+/*
+ * initializes a reader of the lines of a socket, as init_line_reader() does, except that it never
+ * waits for input: read_line() returns NULL with errno EAGAIN until a whole line has come in
+ * returns pointer on success, NULL on failure
+ */
+line_reader_t *init_socket_reader(int fd);
+
+/*
+ * cleans up the reader, the fd itself is left open
+ * Note: this function will free the line_reader pointer
+ */
+void cleanup_line_reader(line_reader_t *reader);
+
+/*
+ * reads the next line, of any length, without its newline
+ * returns the line, which stays valid until the next call, with its length in *len, or NULL at
+ * end of file (errno 0) or on failure (errno set)
+ */
+char *read_line(line_reader_t *reader, size_t *len);
+
+/* returns 1 if read_line() can return without waiting for input, 0 else */
+int has_buffered_line(line_reader_t *reader);
+
+/*
+ * moves the fd's offset back to the first line not yet returned, if fd can seek, so a child
+ * that reads the fd starts where the shell stopped, and picks up from the fd's offset (wherever
+ * the child left it) on the next read_line()
+ * returns 0 on success, -1 on failure
+ */
+int sync_line_reader(line_reader_t *reader);
+
+/*
+ * gets the input read past the lines returned so far if the fd can't seek, which then can't be
+ * handed back to a child, so whatever reads the fd next is to be given it first
+ * returns it, with its length in *len, valid until the next read_line(), or NULL if there is none
+ */
+char *read_ahead(line_reader_t *reader, size_t *len);
+
+/* skips the input read_ahead() returned, once whatever read the fd next has been given it */
+void skip_read_ahead(line_reader_t *reader);
+
+#endif  // LINEREADER_H_
@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include "parser.h"
+
+/* the operators that end a command of a list */
+static int is_separator(token_type_t type){
+  return type == TOKEN_SEMICOLON || type == TOKEN_BACKGROUND || type == TOKEN_AND
+    || type == TOKEN_OR;
+}
+
+static const char *separator_name(token_type_t type){
+  switch (type){
+    case TOKEN_SEMICOLON: return ";";
+    case TOKEN_BACKGROUND: return "&";
+    case TOKEN_AND: return "&&";
+    default: return "||";
+  }
+}
+
+int parse_list(command_list_t *list, token_t *tokens, int num_tokens, arena_t *arena){
+  /* a list has at most one command more than it has separators */
+  int max_commands = 1;
+  for(int i = 0; i < num_tokens; i++){
+    max_commands += is_separator(tokens[i].type);
+  }
+  list->commands = (list_command_t *) arena_alloc(arena,
+    (size_t) max_commands * sizeof(list_command_t));
+  if (list->commands == NULL){
+    fprintf(stderr, "ERROR - Out of memory.\n");
+    return -1;
+  }
+  list->num_commands = 0;
+  list_op_t op = LIST_ALWAYS;
+  int start = 0;
+  for(int i = 0; i <= num_tokens; i++){
+    if (i < num_tokens && !is_separator(tokens[i].type)){
+      continue;
+    }
+    if (i == start){
+      /* a list may end with ";" or "&", or be empty, but there is nothing else between two
+         operators */
+      if (i < num_tokens){
+        fprintf(stderr, "ERROR - %s is only allowed after a command.\n",
+          separator_name(tokens[i].type));
+        return -1;
+      }
+      if (op != LIST_ALWAYS){
+        fprintf(stderr, "ERROR - %s must be followed by a command.\n",
+          op == LIST_AND ? "&&" : "||");
+        return -1;
+      }
+      break;
+    }
+    list_command_t *command = &list->commands[list->num_commands++];
+    command->op = op;
+    command->tokens = &tokens[start];
+    command->num_tokens = i - start;
+    command->background = i < num_tokens && tokens[i].type == TOKEN_BACKGROUND;
+    if (i < num_tokens){
+      op = tokens[i].type == TOKEN_AND ? LIST_AND
+        : (tokens[i].type == TOKEN_OR ? LIST_OR : LIST_ALWAYS);
+    }
+    start = i + 1;
+  }
+  return 0;
+}
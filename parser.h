@@ -0,0 +1,37 @@
+#ifndef PARSER_H_
+#define PARSER_H_
+
+#include "arena.h"
+#include "lexer.h"
+
+/* when a command of a list runs, given the exit status of the one run before it */
+typedef enum list_op {
+  LIST_ALWAYS,  /* the first command, or one after ";" or "&" */
+  LIST_AND,     /* after "&&", only if the status is 0 */
+  LIST_OR       /* after "||", only if it is not */
+} list_op_t;
+
+/* one element of a command list, a pipeline with its redirections (tokens points into the
+   line's tokens, without the operators around it), background if it is followed by "&" */
+typedef struct list_command {
+  list_op_t op;
+  token_t *tokens;
+  int num_tokens;
+  int background;
+} list_command_t;
+
+/* a command list, the commands in the order they are given */
+typedef struct command_list {
+  list_command_t *commands;
+  int num_commands;
+} command_list_t;
+
+/*
+ * parses the tokens of a line into a command list: pipelines separated by ";", "&", "&&" and
+ * "||", all of the same precedence, so "a || b && c" runs c if a or b succeeded, and each "&"
+ * only applies to the pipeline right before it, the list is allocated from arena
+ * returns 0 on success, -1 on a syntax error (which has been printed) or if out of memory
+ */
+int parse_list(command_list_t *list, token_t *tokens, int num_tokens, arena_t *arena);
+
+#endif  // PARSER_H_
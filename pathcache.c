@@ -0,0 +1,305 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "pathcache.h"
+
+/* used when PATH is not set, as most shells do */
+#define DEFAULT_PATH "/usr/local/bin:/usr/bin:/bin"
+/* initial number of buckets, always a power of two */
+#define CACHE_INITIAL_BUCKETS 64
+
+/* one cached command, dir is the index in PATH of the directory it was found in */
+typedef struct cache_entry {
+  char *name;
+  char *path;
+  size_t dir;
+  unsigned long hits;
+  struct cache_entry *next;
+} cache_entry_t;
+
+/* one PATH directory, with its mtime as of the last time it was searched */
+typedef struct cache_dir {
+  char *dir;
+  int have_mtime;
+  struct timespec mtime;
+} cache_dir_t;
+
+/* the cache is process wide, like PATH itself */
+static struct {
+  char *path_var;
+  cache_dir_t *dirs;
+  size_t num_dirs;
+  cache_entry_t **buckets;
+  size_t num_buckets;
+  size_t num_entries;
+} cache;
+
+/* FNV-1a hash of a command name */
+static size_t hash_name(const char *name){
+  size_t h = 14695981039346656037UL;
+  for (const char *c = name; *c != '\0'; c++){
+    h = (h ^ (unsigned char) *c) * 1099511628211UL;
+  }
+  return h;
+}
+
+/* frees every entry, keeping the buckets */
+static void drop_entries(){
+  for (size_t i = 0; i < cache.num_buckets; i++){
+    cache_entry_t *cur = cache.buckets[i];
+    while (cur != NULL){
+      cache_entry_t *next = cur->next;
+      free(cur->name);
+      free(cur->path);
+      free(cur);
+      cur = next;
+    }
+    cache.buckets[i] = NULL;
+  }
+  cache.num_entries = 0;
+}
+
+/* drops the entries found in PATH directory dir or after it, as a change to dir can remove them
+   or shadow them */
+static void drop_entries_from(size_t dir){
+  for (size_t i = 0; i < cache.num_buckets; i++){
+    cache_entry_t **link = &cache.buckets[i];
+    while (*link != NULL){
+      cache_entry_t *cur = *link;
+      if (cur->dir >= dir){
+        *link = cur->next;
+        free(cur->name);
+        free(cur->path);
+        free(cur);
+        cache.num_entries--;
+      } else {
+        link = &cur->next;
+      }
+    }
+  }
+}
+
+/* frees the split up PATH */
+static void drop_dirs(){
+  for (size_t i = 0; i < cache.num_dirs; i++){
+    free(cache.dirs[i].dir);
+  }
+  free(cache.dirs);
+  free(cache.path_var);
+  cache.dirs = NULL;
+  cache.num_dirs = 0;
+  cache.path_var = NULL;
+}
+
+/*
+ * sync_path() - makes sure the cache was built for the current value of PATH, splitting it up
+ *               into directories (and dropping every entry) if it changed
+ *
+ * Returns:
+ *	- 0 on success, -1 if memory could not be allocated
+ */
+static int sync_path(){
+  const char *path_var = getenv("PATH");
+  if (path_var == NULL){
+    path_var = DEFAULT_PATH;
+  }
+  if (cache.path_var != NULL && !strcmp(cache.path_var, path_var)){
+    return 0;
+  }
+  drop_entries();
+  drop_dirs();
+  if (cache.buckets == NULL){
+    cache.buckets = (cache_entry_t **) calloc(CACHE_INITIAL_BUCKETS, sizeof(cache_entry_t *));
+    if (cache.buckets == NULL){
+      return -1;
+    }
+    cache.num_buckets = CACHE_INITIAL_BUCKETS;
+  }
+  if ((cache.path_var = strdup(path_var)) == NULL){
+    return -1;
+  }
+  /* splits on ':', an empty entry means the current directory */
+  size_t num_dirs = 1;
+  for (const char *c = path_var; *c != '\0'; c++){
+    num_dirs += (*c == ':');
+  }
+  if ((cache.dirs = (cache_dir_t *) calloc(num_dirs, sizeof(cache_dir_t))) == NULL){
+    drop_dirs();
+    return -1;
+  }
+  const char *start = path_var;
+  for (size_t i = 0; i < num_dirs; i++){
+    size_t len = strcspn(start, ":");
+    cache.dirs[i].dir = len ? strndup(start, len) : strdup(".");
+    if (cache.dirs[i].dir == NULL){
+      cache.num_dirs = i;
+      drop_dirs();
+      return -1;
+    }
+    start += len + 1;
+  }
+  cache.num_dirs = num_dirs;
+  return 0;
+}
+
+/* finds the entry of a command, returns NULL if it is not cached */
+static cache_entry_t *find_entry(const char *name){
+  if (cache.buckets == NULL){
+    return NULL;
+  }
+  cache_entry_t *cur = cache.buckets[hash_name(name) & (cache.num_buckets - 1)];
+  while (cur != NULL && strcmp(cur->name, name)){
+    cur = cur->next;
+  }
+  return cur;
+}
+
+/* adds an entry, doubling the buckets once there are as many entries, returns NULL on failure */
+static cache_entry_t *add_entry(const char *name, char *path, size_t dir){
+  if (cache.num_entries >= cache.num_buckets){
+    size_t num_buckets = cache.num_buckets * 2;
+    cache_entry_t **buckets = (cache_entry_t **) calloc(num_buckets, sizeof(cache_entry_t *));
+    if (buckets != NULL){
+      for (size_t i = 0; i < cache.num_buckets; i++){
+        cache_entry_t *cur = cache.buckets[i];
+        while (cur != NULL){
+          cache_entry_t *next = cur->next;
+          size_t b = hash_name(cur->name) & (num_buckets - 1);
+          cur->next = buckets[b];
+          buckets[b] = cur;
+          cur = next;
+        }
+      }
+      free(cache.buckets);
+      cache.buckets = buckets;
+      cache.num_buckets = num_buckets;
+    }
+  }
+  cache_entry_t *entry = (cache_entry_t *) malloc(sizeof(cache_entry_t));
+  if (entry == NULL || (entry->name = strdup(name)) == NULL){
+    free(entry);
+    return NULL;
+  }
+  entry->path = path;
+  entry->dir = dir;
+  entry->hits = 0;
+  size_t b = hash_name(name) & (cache.num_buckets - 1);
+  entry->next = cache.buckets[b];
+  cache.buckets[b] = entry;
+  cache.num_entries++;
+  return entry;
+}
+
+/*
+ * resolves a command name (one without a '/') through PATH, remembering the result so later
+ * lookups of the same name make no file system probes at all
+ * returns the resolved path, which stays valid until the entry is dropped, or NULL with errno set
+ * if the command was not found
+ */
+const char *resolve_command(const char *name){
+  if (sync_path() == -1){
+    errno = ENOMEM;
+    return NULL;
+  }
+  cache_entry_t *entry = find_entry(name);
+  if (entry != NULL){
+    entry->hits++;
+    return entry->path;
+  }
+  /* a miss searches PATH in order, and since that means going to the file system anyway, it
+     is also when a directory whose mtime changed has its entries (and later ones) dropped */
+  size_t name_len = strlen(name);
+  for (size_t i = 0; i < cache.num_dirs; i++){
+    cache_dir_t *dir = &cache.dirs[i];
+    struct stat dir_st;
+    if (stat(dir->dir, &dir_st) == -1){
+      continue;
+    }
+    if (!dir->have_mtime || dir_st.st_mtim.tv_sec != dir->mtime.tv_sec
+        || dir_st.st_mtim.tv_nsec != dir->mtime.tv_nsec){
+      if (dir->have_mtime){
+        drop_entries_from(i);
+      }
+      dir->have_mtime = 1;
+      dir->mtime = dir_st.st_mtim;
+    }
+    size_t dir_len = strlen(dir->dir);
+    char *path = (char *) malloc(dir_len + name_len + 2);
+    if (path == NULL){
+      errno = ENOMEM;
+      return NULL;
+    }
+    memcpy(path, dir->dir, dir_len);
+    path[dir_len] = '/';
+    memcpy(path + dir_len + 1, name, name_len + 1);
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISREG(st.st_mode) && access(path, X_OK) == 0){
+      entry = add_entry(name, path, i);
+      if (entry == NULL){
+        free(path);
+        errno = ENOMEM;
+        return NULL;
+      }
+      entry->hits++;
+      return entry->path;
+    }
+    free(path);
+  }
+  errno = ENOENT;
+  return NULL;
+}
+
+/* drops the cached path of a command, e.g. after exec on it failed, returns 0 on success, -1 if
+   it was not cached */
+int forget_command(const char *name){
+  if (cache.buckets == NULL){
+    return -1;
+  }
+  cache_entry_t **link = &cache.buckets[hash_name(name) & (cache.num_buckets - 1)];
+  while (*link != NULL){
+    cache_entry_t *cur = *link;
+    if (!strcmp(cur->name, name)){
+      *link = cur->next;
+      free(cur->name);
+      free(cur->path);
+      free(cur);
+      cache.num_entries--;
+      return 0;
+    }
+    link = &cur->next;
+  }
+  return -1;
+}
+
+/* drops every cached path and directory mtime (hash -r) */
+void reset_path_cache(){
+  if (cache.buckets != NULL){
+    drop_entries();
+  }
+  drop_dirs();
+}
+
+/* prints the cached commands with their hit counts (hash with no arguments) */
+void print_path_cache(){
+  if (cache.num_entries == 0){
+    printf("hash: hash table empty\n");
+    return;
+  }
+  printf("hits\tcommand\n");
+  for (size_t i = 0; i < cache.num_buckets; i++){
+    for (cache_entry_t *cur = cache.buckets[i]; cur != NULL; cur = cur->next){
+      printf("%4lu\t%s\n", cur->hits, cur->path);
+    }
+  }
+}
+
+/* frees the cache, it may still be used afterwards and starts out empty */
+void cleanup_path_cache(){
+  reset_path_cache();
+  free(cache.buckets);
+  cache.buckets = NULL;
+  cache.num_buckets = 0;
+}
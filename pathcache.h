@@ -0,0 +1,25 @@
+#ifndef PATHCACHE_H_
+#define PATHCACHE_H_
+
+/*
+ * resolves a command name (one without a '/') through PATH, remembering the result so later
+ * lookups of the same name make no file system probes at all
+ * returns the resolved path, which stays valid until the entry is dropped, or NULL with errno set
+ * if the command was not found
+ */
+const char *resolve_command(const char *name);
+
+/* drops the cached path of a command, e.g. after exec on it failed, returns 0 on success, -1 if
+   it was not cached */
+int forget_command(const char *name);
+
+/* drops every cached path and directory mtime (hash -r) */
+void reset_path_cache();
+
+/* prints the cached commands with their hit counts (hash with no arguments) */
+void print_path_cache();
+
+/* frees the cache, it may still be used afterwards and starts out empty */
+void cleanup_path_cache();
+
+#endif  // PATHCACHE_H_
@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "placement.h"
+
+/* NUMA nodes looked at, more than any machine the shell runs on has */
+#define PLACEMENT_MAX_NODES 64
+
+/* one NUMA node with the CPUs of it the shell may use, id -1 standing for all of them when the
+   kernel has no NUMA information */
+typedef struct placement_node {
+  int id;
+  cpu_set_t cpus;
+  int num_cpus;
+} placement_node_t;
+
+/* the placement is process wide, like the affinity the shell starts with, found on first use */
+static struct {
+  placement_policy_t policy;
+  int initialized;
+  cpu_set_t allowed;
+  int held[CPU_SETSIZE];
+  int next_cpu;
+  placement_node_t nodes[PLACEMENT_MAX_NODES];
+  int num_nodes;
+  int next_node;
+} placement;
+
+int parse_cpu_list(const char *list, cpu_set_t *cpus){
+  CPU_ZERO(cpus);
+  const char *cur = list;
+  while (*cur != '\0' && *cur != '\n'){
+    char *end;
+    long first = strtol(cur, &end, 10);
+    long last = first;
+    if (end == cur){
+      return -1;
+    }
+    if (*end == '-'){
+      cur = end + 1;
+      last = strtol(cur, &end, 10);
+      if (end == cur){
+        return -1;
+      }
+    }
+    if (first < 0 || last < first || last >= CPU_SETSIZE){
+      return -1;
+    }
+    for (long cpu = first; cpu <= last; cpu++){
+      CPU_SET((size_t) cpu, cpus);
+    }
+    cur = end;
+    if (*cur == ','){
+      cur++;
+    } else if (*cur != '\0' && *cur != '\n'){
+      return -1;
+    }
+  }
+  return CPU_COUNT(cpus) > 0 ? 0 : -1;
+}
+
+/* reads a list (as parse_cpu_list() takes) from a sysfs file, returns 0 on success, -1 else */
+static int read_list_file(const char *path, cpu_set_t *cpus){
+  FILE *file = fopen(path, "r");
+  if (file == NULL){
+    return -1;
+  }
+  char line[4096];
+  int found = fgets(line, sizeof(line), file) != NULL && parse_cpu_list(line, cpus) == 0;
+  fclose(file);
+  return found ? 0 : -1;
+}
+
+/* finds the CPUs the shell may use and the nodes they are on */
+static void init_placement(){
+  if (placement.initialized){
+    return;
+  }
+  placement.initialized = 1;
+  if (sched_getaffinity(0, sizeof(placement.allowed), &placement.allowed) == -1){
+    CPU_ZERO(&placement.allowed);
+  }
+  cpu_set_t online;
+  if (read_list_file("/sys/devices/system/node/online", &online) == 0){
+    for (int id = 0; id < PLACEMENT_MAX_NODES; id++){
+      if (!CPU_ISSET((size_t) id, &online)){
+        continue;
+      }
+      char path[64];
+      snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", id);
+      placement_node_t *node = &placement.nodes[placement.num_nodes];
+      /* a node with memory only, or none of the shell's CPUs, has nothing to run a job on */
+      if (read_list_file(path, &node->cpus) == -1){
+        continue;
+      }
+      CPU_AND(&node->cpus, &node->cpus, &placement.allowed);
+      node->num_cpus = CPU_COUNT(&node->cpus);
+      if (node->num_cpus > 0){
+        node->id = id;
+        placement.num_nodes++;
+      }
+    }
+  }
+  if (!placement.num_nodes && CPU_COUNT(&placement.allowed) > 0){
+    placement.nodes[0].id = -1;
+    placement.nodes[0].cpus = placement.allowed;
+    placement.nodes[0].num_cpus = CPU_COUNT(&placement.allowed);
+    placement.num_nodes = 1;
+  }
+}
+
+void set_placement_policy(placement_policy_t policy){
+  placement.policy = policy;
+}
+
+placement_policy_t get_placement_policy(){
+  return placement.policy;
+}
+
+/* the number of jobs holding a node's CPUs, summed over them */
+static long node_load(const placement_node_t *node){
+  long load = 0;
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++){
+    if (CPU_ISSET((size_t) cpu, &node->cpus)){
+      load += placement.held[cpu];
+    }
+  }
+  return load;
+}
+
+int place_job(cpu_set_t *cpus, int *node){
+  if (placement.policy == PLACE_NONE){
+    return -1;
+  }
+  init_placement();
+  CPU_ZERO(cpus);
+  *node = -1;
+  if (placement.policy == PLACE_CORES){
+    /* the least held CPU, starting after the last one handed out */
+    int best = -1;
+    for (int i = 0; i < CPU_SETSIZE; i++){
+      int cpu = (placement.next_cpu + i) % CPU_SETSIZE;
+      if (CPU_ISSET((size_t) cpu, &placement.allowed)
+          && (best == -1 || placement.held[cpu] < placement.held[best])){
+        best = cpu;
+      }
+    }
+    if (best == -1){
+      return -1;
+    }
+    CPU_SET((size_t) best, cpus);
+    placement.next_cpu = (best + 1) % CPU_SETSIZE;
+    return 0;
+  }
+  /* the node with the fewest jobs per CPU, starting after the last one handed out */
+  if (!placement.num_nodes){
+    return -1;
+  }
+  int best = -1;
+  long best_load = 0;
+  for (int i = 0; i < placement.num_nodes; i++){
+    int index = (placement.next_node + i) % placement.num_nodes;
+    long load = node_load(&placement.nodes[index]);
+    if (best == -1
+        || load * placement.nodes[best].num_cpus < best_load * placement.nodes[index].num_cpus){
+      best = index;
+      best_load = load;
+    }
+  }
+  *cpus = placement.nodes[best].cpus;
+  *node = placement.nodes[best].id;
+  placement.next_node = (best + 1) % placement.num_nodes;
+  return 0;
+}
+
+void hold_cpus(const cpu_set_t *cpus){
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++){
+    if (CPU_ISSET((size_t) cpu, cpus)){
+      placement.held[cpu]++;
+    }
+  }
+}
+
+void release_cpus(const cpu_set_t *cpus){
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++){
+    if (CPU_ISSET((size_t) cpu, cpus) && placement.held[cpu] > 0){
+      placement.held[cpu]--;
+    }
+  }
+}
+
+void print_placement(){
+  static const char *names[] = {"none", "cores", "nodes"};
+  init_placement();
+  printf("policy %s\n", names[placement.policy]);
+  for (int i = 0; i < placement.num_nodes; i++){
+    const placement_node_t *node = &placement.nodes[i];
+    if (node->id != -1){
+      printf("node %d:", node->id);
+    } else {
+      printf("cpus:");
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++){
+      if (CPU_ISSET((size_t) cpu, &node->cpus)){
+        printf(" cpu %d (%d jobs)", cpu, placement.held[cpu]);
+      }
+    }
+    printf("\n");
+  }
+}
@@ -0,0 +1,42 @@
+#ifndef PLACEMENT_H_
+#define PLACEMENT_H_
+
+#include <sched.h>
+
+/*
+ * Where background jobs run: by default wherever the kernel puts them, or pinned to CPUs picked
+ * here, always the ones the fewest running jobs hold (going round robin between equals), so a
+ * core or node a job gives back is the next one handed out. Only the CPUs the shell itself may
+ * run on are used.
+ */
+typedef enum placement_policy {
+  /* jobs get the shell's own CPUs */
+  PLACE_NONE,
+  /* each job gets one core */
+  PLACE_CORES,
+  /* each job gets the CPUs of one NUMA node, and prefers that node for its memory */
+  PLACE_NODES
+} placement_policy_t;
+
+/* sets and gets the policy, PLACE_NONE to begin with */
+void set_placement_policy(placement_policy_t policy);
+placement_policy_t get_placement_policy();
+
+/*
+ * picks the CPUs for a new job under the policy into cpus, and its NUMA node into node (-1 if it
+ * has none), they count as held once hold_cpus() is called
+ * returns 0 on success, -1 if the policy is PLACE_NONE or there are no CPUs to pick from
+ */
+int place_job(cpu_set_t *cpus, int *node);
+
+/* parses a list of CPUs such as "0-3,6" into cpus, returns 0 on success, -1 if it is not one */
+int parse_cpu_list(const char *list, cpu_set_t *cpus);
+
+/* counts a job's CPUs as held by it, and as free again once it is done */
+void hold_cpus(const cpu_set_t *cpus);
+void release_cpus(const cpu_set_t *cpus);
+
+/* prints the policy, and how many jobs hold each CPU (placement with no arguments) */
+void print_placement();
+
+#endif  // PLACEMENT_H_
@@ -0,0 +1,329 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "queue.h"
+
+/* the default pressure limits, in percent of the last 10 seconds some task stalled on it */
+#define QUEUE_DEFAULT_CPU 80.0
+#define QUEUE_DEFAULT_MEMORY 10.0
+/* how often a queue held back by pressure checks it again */
+#define QUEUE_RETRY_MS 1000
+
+/* one submitted command, argv pointing into strings, command being it for display, jid the job
+   running it and status how it finished (as from waitpid) */
+typedef struct queue_entry {
+  int qid;
+  int priority;
+  unsigned long seq;
+  char **argv;
+  char *strings;
+  char *command;
+  int jid;
+  int status;
+} queue_entry_t;
+
+/* a growable array of entries */
+typedef struct entry_array {
+  queue_entry_t **entries;
+  size_t num_entries;
+  size_t capacity;
+} entry_array_t;
+
+/* queued is a binary heap (see comes_before()), running and finished are in the order they
+   started and finished */
+struct job_queue {
+  queue_limits_t limits;
+  entry_array_t queued;
+  entry_array_t running;
+  entry_array_t finished;
+  int next_qid;
+  unsigned long next_seq;
+};
+
+/* appends an entry, returns 0 on success, -1 on failure */
+static int push_entry(entry_array_t *array, queue_entry_t *entry){
+  if (array->num_entries == array->capacity){
+    size_t capacity = array->capacity ? array->capacity * 2 : 16;
+    queue_entry_t **entries = (queue_entry_t **) realloc(array->entries,
+      capacity * sizeof(queue_entry_t *));
+    if (entries == NULL){
+      return -1;
+    }
+    array->entries = entries;
+    array->capacity = capacity;
+  }
+  array->entries[array->num_entries++] = entry;
+  return 0;
+}
+
+static void free_entry(queue_entry_t *entry){
+  free(entry->argv);
+  free(entry->strings);
+  free(entry->command);
+  free(entry);
+}
+
+static void free_entries(entry_array_t *array){
+  for (size_t i = 0; i < array->num_entries; i++){
+    free_entry(array->entries[i]);
+  }
+  free(array->entries);
+}
+
+/* 1 if a is to start before b: a higher priority, or the same one and submitted earlier */
+static int comes_before(const queue_entry_t *a, const queue_entry_t *b){
+  return a->priority != b->priority ? a->priority > b->priority : a->seq < b->seq;
+}
+
+static int compare_entries(const void *a, const void *b){
+  return comes_before(*(queue_entry_t * const *) a, *(queue_entry_t * const *) b) ? -1 : 1;
+}
+
+/* moves the last entry of the heap up to its place */
+static void sift_up(entry_array_t *heap){
+  size_t i = heap->num_entries - 1;
+  while (i > 0 && comes_before(heap->entries[i], heap->entries[(i - 1) / 2])){
+    queue_entry_t *parent = heap->entries[(i - 1) / 2];
+    heap->entries[(i - 1) / 2] = heap->entries[i];
+    heap->entries[i] = parent;
+    i = (i - 1) / 2;
+  }
+}
+
+/* removes the first entry of the heap, returns it */
+static queue_entry_t *pop_first(entry_array_t *heap){
+  queue_entry_t *first = heap->entries[0];
+  heap->entries[0] = heap->entries[--heap->num_entries];
+  size_t i = 0;
+  while (1){
+    size_t best = i;
+    size_t left = 2 * i + 1;
+    size_t right = left + 1;
+    if (left < heap->num_entries && comes_before(heap->entries[left], heap->entries[best])){
+      best = left;
+    }
+    if (right < heap->num_entries && comes_before(heap->entries[right], heap->entries[best])){
+      best = right;
+    }
+    if (best == i){
+      return first;
+    }
+    queue_entry_t *swap = heap->entries[best];
+    heap->entries[best] = heap->entries[i];
+    heap->entries[i] = swap;
+    i = best;
+  }
+}
+
+job_queue_t *init_job_queue(){
+  job_queue_t *queue = (job_queue_t *) calloc(1, sizeof(job_queue_t));
+  if (queue == NULL){
+    return NULL;
+  }
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  queue->limits.slots = cpus > 0 ? (int) cpus : 1;
+  queue->limits.cpu = QUEUE_DEFAULT_CPU;
+  queue->limits.memory = QUEUE_DEFAULT_MEMORY;
+  queue->next_qid = 1;
+  return queue;
+}
+
+void cleanup_job_queue(job_queue_t *queue){
+  if (queue == NULL){
+    return;
+  }
+  free_entries(&queue->queued);
+  free_entries(&queue->running);
+  free_entries(&queue->finished);
+  free(queue);
+}
+
+void get_queue_limits(job_queue_t *queue, queue_limits_t *limits){
+  *limits = queue->limits;
+}
+
+void set_queue_limits(job_queue_t *queue, const queue_limits_t *limits){
+  queue->limits = *limits;
+}
+
+int enqueue_command(job_queue_t *queue, int priority, char **argv){
+  size_t size = 0;
+  int argc = 0;
+  for (; argv[argc] != NULL; argc++){
+    size += strlen(argv[argc]) + 1;
+  }
+  queue_entry_t *entry = (queue_entry_t *) calloc(1, sizeof(queue_entry_t));
+  if (entry == NULL){
+    return -1;
+  }
+  entry->argv = (char **) malloc((size_t) (argc + 1) * sizeof(char *));
+  entry->strings = (char *) malloc(size);
+  entry->command = (char *) malloc(size);
+  if (entry->argv == NULL || entry->strings == NULL || entry->command == NULL
+      || push_entry(&queue->queued, entry) == -1){
+    free_entry(entry);
+    return -1;
+  }
+  /* the arguments one after another, and for display joined by spaces */
+  char *end = entry->strings;
+  for (int i = 0; i < argc; i++){
+    entry->argv[i] = end;
+    end = stpcpy(end, argv[i]) + 1;
+  }
+  entry->argv[argc] = NULL;
+  memcpy(entry->command, entry->strings, size);
+  for (size_t i = 0; i + 1 < size; i++){
+    if (entry->command[i] == '\0'){
+      entry->command[i] = ' ';
+    }
+  }
+  entry->qid = queue->next_qid++;
+  entry->priority = priority;
+  entry->seq = queue->next_seq++;
+  entry->jid = -1;
+  sift_up(&queue->queued);
+  return entry->qid;
+}
+
+int read_pressure(const char *resource, double *avg10){
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/pressure/%s", resource);
+  FILE *file = fopen(path, "r");
+  if (file == NULL){
+    return -1;
+  }
+  /* the first line is "some avg10=... avg60=... avg300=... total=..." */
+  int found = fscanf(file, "some avg10=%lf", avg10);
+  fclose(file);
+  return found == 1 ? 0 : -1;
+}
+
+/* reads the cpu pressure, or without PSI the load average per CPU, in percent, returns 0 on
+   success, -1 if neither can be read */
+static int read_cpu_pressure(double *percent){
+  if (read_pressure("cpu", percent) == 0){
+    return 0;
+  }
+  double load;
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (getloadavg(&load, 1) != 1){
+    return -1;
+  }
+  *percent = load * 100 / (double) (cpus > 0 ? cpus : 1);
+  return 0;
+}
+
+/* 1 if the pressure is at or over a limit, 0 else (or if it can't be read) */
+static int over_pressure(job_queue_t *queue){
+  double pressure;
+  if (queue->limits.cpu > 0 && read_cpu_pressure(&pressure) == 0
+      && pressure >= queue->limits.cpu){
+    return 1;
+  }
+  if (queue->limits.memory > 0 && read_pressure("memory", &pressure) == 0
+      && pressure >= queue->limits.memory){
+    return 1;
+  }
+  return 0;
+}
+
+/* 1 if every slot is taken */
+static int queue_full(job_queue_t *queue){
+  return queue->limits.slots > 0
+    && queue->running.num_entries >= (size_t) queue->limits.slots;
+}
+
+char **next_queued(job_queue_t *queue){
+  if (!queue->queued.num_entries || queue_full(queue) || over_pressure(queue)){
+    return NULL;
+  }
+  return queue->queued.entries[0]->argv;
+}
+
+void started_queued(job_queue_t *queue, int jid, int status){
+  queue_entry_t *entry = pop_first(&queue->queued);
+  entry->jid = jid;
+  entry->status = status;
+  if (push_entry(jid == -1 ? &queue->finished : &queue->running, entry) == -1){
+    free_entry(entry);
+  }
+}
+
+int finish_queued(job_queue_t *queue, int jid, int status){
+  for (size_t i = 0; i < queue->running.num_entries; i++){
+    queue_entry_t *entry = queue->running.entries[i];
+    if (entry->jid == jid){
+      memmove(&queue->running.entries[i], &queue->running.entries[i + 1],
+        (queue->running.num_entries - i - 1) * sizeof(queue_entry_t *));
+      queue->running.num_entries--;
+      entry->status = status;
+      if (push_entry(&queue->finished, entry) == -1){
+        free_entry(entry);
+      }
+      return 0;
+    }
+  }
+  return -1;
+}
+
+int queue_pending(job_queue_t *queue){
+  return (int) (queue->queued.num_entries + queue->running.num_entries);
+}
+
+int queue_retry_ms(job_queue_t *queue){
+  if (!queue->queued.num_entries || queue_full(queue)){
+    return -1;
+  }
+  return QUEUE_RETRY_MS;
+}
+
+void print_queue(job_queue_t *queue){
+  /* the heap is only ordered enough to find the first entry, so a copy is sorted */
+  size_t num_queued = queue->queued.num_entries;
+  queue_entry_t **sorted = (queue_entry_t **) malloc((num_queued + 1) * sizeof(queue_entry_t *));
+  if (sorted != NULL){
+    memcpy(sorted, queue->queued.entries, num_queued * sizeof(queue_entry_t *));
+    qsort(sorted, num_queued, sizeof(queue_entry_t *), compare_entries);
+    for (size_t i = 0; i < num_queued; i++){
+      printf("[q%d] Queued (priority %d) %s\n", sorted[i]->qid, sorted[i]->priority,
+        sorted[i]->command);
+    }
+    free(sorted);
+  }
+  for (size_t i = 0; i < queue->finished.num_entries; i++){
+    queue_entry_t *entry = queue->finished.entries[i];
+    if (entry->jid == -1){
+      printf("[q%d] Not started %s\n", entry->qid, entry->command);
+    } else if (WIFSIGNALED(entry->status)){
+      printf("[q%d] Done [%d], terminated by signal %d %s\n", entry->qid, entry->jid,
+        WTERMSIG(entry->status), entry->command);
+    } else {
+      printf("[q%d] Done [%d], exit status %d %s\n", entry->qid, entry->jid,
+        WEXITSTATUS(entry->status), entry->command);
+    }
+    free_entry(entry);
+  }
+  queue->finished.num_entries = 0;
+}
+
+void print_queue_limits(job_queue_t *queue){
+  double cpu, memory;
+  int have_cpu = read_cpu_pressure(&cpu) == 0;
+  int have_memory = read_pressure("memory", &memory) == 0;
+  printf("slots %d, cpu %.1f%%, memory %.1f%% (0 is no limit)\n", queue->limits.slots,
+    queue->limits.cpu, queue->limits.memory);
+  if (have_cpu){
+    printf("cpu pressure %.1f%%, ", cpu);
+  } else {
+    printf("cpu pressure unknown, ");
+  }
+  if (have_memory){
+    printf("memory pressure %.1f%%\n", memory);
+  } else {
+    printf("memory pressure unknown\n");
+  }
+  printf("%zu queued, %zu running, %zu finished\n", queue->queued.num_entries,
+    queue->running.num_entries, queue->finished.num_entries);
+}
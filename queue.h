@@ -0,0 +1,74 @@
+#ifndef QUEUE_H_
+#define QUEUE_H_
+
+/*
+ * A queue of commands waiting to run as background jobs (submit), highest priority first and in
+ * order of submission within a priority, started only while the limits below allow. Each entry
+ * has a queue id, and is queued, then running as a job (known by its job id), then finished.
+ */
+typedef struct job_queue job_queue_t;
+
+/* the limits a queued command is started under, 0 meaning no limit */
+typedef struct queue_limits {
+  /* queued commands running at once */
+  int slots;
+  /* "some avg10" of /proc/pressure/cpu in percent, or without PSI the 1 minute load average
+     per CPU in percent */
+  double cpu;
+  /* "some avg10" of /proc/pressure/memory in percent, not checked without PSI */
+  double memory;
+} queue_limits_t;
+
+/* initializes an empty queue, with a slot per CPU and the default pressure limits, returns
+   pointer on success, NULL on failure */
+job_queue_t *init_job_queue();
+
+/*
+ * cleans up the queue, dropping the commands still queued
+ * Note: this function will free the queue pointer
+ */
+void cleanup_job_queue(job_queue_t *queue);
+
+/* gets and sets the limits */
+void get_queue_limits(job_queue_t *queue, queue_limits_t *limits);
+void set_queue_limits(job_queue_t *queue, const queue_limits_t *limits);
+
+/* queues a command with a priority (higher first), argv being copied, returns its queue id on
+   success, -1 on failure */
+int enqueue_command(job_queue_t *queue, int priority, char **argv);
+
+/*
+ * gets the command to start next, if there is one and the limits allow starting it now, which
+ * stays valid (and may be changed) until started_queued() is called, NULL else
+ */
+char **next_queued(job_queue_t *queue);
+
+/* marks the command from next_queued() as running as job jid, or as finished with status if it
+   could not be started (jid -1) */
+void started_queued(job_queue_t *queue, int jid, int status);
+
+/* marks the running entry of job jid as finished with status (as from waitpid), returns 0 on
+   success, -1 if the job is not one the queue started */
+int finish_queued(job_queue_t *queue, int jid, int status);
+
+/* the number of entries queued or running */
+int queue_pending(job_queue_t *queue);
+
+/* how long to wait before checking the pressure again, in milliseconds, for a queue that is
+   held back only by the pressure limits, -1 if the queue has nothing to start or is full */
+int queue_retry_ms(job_queue_t *queue);
+
+/*
+ * reads the "some avg10" of /proc/pressure/resource ("cpu", "memory") into avg10
+ * returns 0 on success, -1 if there is no such pressure information
+ */
+int read_pressure(const char *resource, double *avg10);
+
+/* prints the queued entries in the order they will start, then the ones finished since the last
+   call, which are then dropped (jobs) */
+void print_queue(job_queue_t *queue);
+
+/* prints the limits, the current pressure and the number of entries in each state (queue) */
+void print_queue_limits(job_queue_t *queue);
+
+#endif  // QUEUE_H_
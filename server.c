@@ -0,0 +1,133 @@
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "server.h"
+
+/* the arena of a session starts as big as the shell's own */
+#define SESSION_ARENA_SIZE 16384
+
+/* the listening socket and its address, the directory sessions start in and the sessions, newest
+   first */
+static struct {
+  int fd;
+  int cwd;
+  struct sockaddr_un addr;
+  session_t *sessions;
+  int num_sessions;
+} server = {-1, -1, {AF_UNIX, ""}, NULL, 0};
+
+int open_server(const char *path){
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)){
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd == -1){
+    return -1;
+  }
+  /* a socket left by a server that is gone is replaced, anything else at path is not */
+  struct stat st;
+  if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)){
+    unlink(path);
+  }
+  if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1 || listen(fd, SOMAXCONN) == -1
+      || (server.cwd = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC)) == -1){
+    int error = errno;
+    close(fd);
+    errno = error;
+    return -1;
+  }
+  server.addr = addr;
+  server.fd = fd;
+  return fd;
+}
+
+void close_server(){
+  if (server.fd == -1){
+    return;
+  }
+  close(server.fd);
+  close(server.cwd);
+  unlink(server.addr.sun_path);
+  server.fd = -1;
+}
+
+session_t *accept_session(){
+  int fd = accept4(server.fd, NULL, NULL, SOCK_CLOEXEC);
+  if (fd == -1){
+    return NULL;
+  }
+  session_t *session = (session_t *) calloc(1, sizeof(session_t));
+  if (session == NULL){
+    close(fd);
+    errno = ENOMEM;
+    return NULL;
+  }
+  session->fd = fd;
+  session->cwd = fcntl(server.cwd, F_DUPFD_CLOEXEC, 0);
+  session->reader = init_socket_reader(fd);
+  session->arena = init_arena(SESSION_ARENA_SIZE);
+  session->jobs = init_job_list();
+  session->next_command = -1;
+  session->waiting_jid = -1;
+  if (session->cwd == -1 || session->reader == NULL || session->arena == NULL
+      || session->jobs == NULL){
+    close_session(session);
+    errno = ENOMEM;
+    return NULL;
+  }
+  session->next = server.sessions;
+  server.sessions = session;
+  server.num_sessions++;
+  return session;
+}
+
+void close_session(session_t *session){
+  for (session_t **cur = &server.sessions; *cur != NULL; cur = &(*cur)->next){
+    if (*cur == session){
+      *cur = session->next;
+      server.num_sessions--;
+      break;
+    }
+  }
+  close(session->fd);
+  if (session->cwd != -1){
+    close(session->cwd);
+  }
+  cleanup_line_reader(session->reader);
+  if (session->arena != NULL){
+    cleanup_arena(session->arena);
+  }
+  if (session->jobs != NULL){
+    cleanup_job_list(session->jobs);
+  }
+  cleanup_job_queue(session->queue);
+  free(session);
+}
+
+session_t *get_sessions(){
+  return server.sessions;
+}
+
+int get_num_sessions(){
+  return server.num_sessions;
+}
+
+session_t *find_session(pid_t pid){
+  for (session_t *session = server.sessions; session != NULL; session = session->next){
+    if (get_job_jid(session->jobs, pid) != -1){
+      return session;
+    }
+  }
+  return NULL;
+}
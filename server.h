@@ -0,0 +1,59 @@
+#ifndef SERVER_H_
+#define SERVER_H_
+
+#include <sys/types.h>
+#include "jobs.h"
+#include "linereader.h"
+#include "arena.h"
+#include "parser.h"
+#include "queue.h"
+
+/*
+ * A shell started with --server listens on a Unix socket, and each client that connects gets a
+ * session of its own, as if it had a shell to itself: the lines it sends are run with its own
+ * job list, working directory, last status and submit queue, and the client's socket is the
+ * standard output and error of what they run, so a child writes to the client directly.
+ */
+
+/* one client's session, commands being the line it is running (parsed into arena) from
+   next_command on, which waits while waiting_jid is its foreground job */
+typedef struct session {
+  int fd;
+  line_reader_t *reader;
+  arena_t *arena;
+  job_list_t *jobs;
+  int jid;
+  int cwd;
+  int last_status;
+  job_queue_t *queue;
+  command_list_t commands;
+  int next_command;
+  int waiting_jid;
+  int input_done;
+  struct session *next;
+} session_t;
+
+/* listens on a Unix socket at path (replacing a socket left there), sessions starting in the
+   current working directory, returns the listening fd on success, -1 on failure */
+int open_server(const char *path);
+
+/* stops listening and removes the socket */
+void close_server();
+
+/* accepts a client and starts its session, returns it on success, NULL on failure (errno
+   EAGAIN if no client is waiting) */
+session_t *accept_session();
+
+/* ends a session, closing the client's socket and dropping its jobs from the shell's view */
+void close_session(session_t *session);
+
+/* gets the first session, the others follow through next, NULL if there is none */
+session_t *get_sessions();
+
+/* gets the number of sessions */
+int get_num_sessions();
+
+/* gets the session one of whose jobs has the process pid, NULL if there is none */
+session_t *find_session(pid_t pid);
+
+#endif  // SERVER_H_
@@ -1,687 +1,2819 @@
-#include <unistd.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <stdint.h>
-#include <string.h>
-#include <sys/wait.h>
-#include <fcntl.h>
-#include "jobs.h"
-
-/*
- * count_tokens() - counts the number of tokens in buffer
- *
- * Parameters:
- *	- buffer: a char* to the start of the user input buffer
- *
- * Returns:
- *	- an integer representing the number of tokens in the buffer
- */
-int count_tokens(char* buffer){
-  /* if leading whitespace, buffer incremented */
-  size_t lead_whitespace = strspn(buffer, "\t ");
-  buffer += lead_whitespace;
-  /* uses strcspn and strspn to cout tokens based delimiters in user input */
-  int num_tok = 0;
-  size_t i1 = 0;
-  while(strcspn((buffer + i1), "\t ") != 0){
-    size_t plus = strcspn((buffer + i1), "\t ");
-    size_t num_delim = strspn((buffer + i1 + plus), "\t ");
-    i1 += (plus + num_delim);
-    num_tok++;
-  }
-  return num_tok;
-}
-
-/*
- * tokenize() - tokenizes the buffer by filling a string array of the buffer's tokens
- *
- * Parameters:
- *	- arr: an array of strings (char**) to hold all the tokens (including redirection)
- *         from the buffer
- *	- buffer: a char* to the start of the user input buffer
- *
- * Returns:
- *	- nothing (void) - the char** should be set
- */
-void tokenize(char** arr, char* buffer){
-  char* argument = strtok(buffer, "\t ");
-  int i2 = 0;
-  while (argument != NULL){
-    arr[i2] = argument;
-    argument = strtok(NULL, "\t ");
-    i2++;
-  }
-}
-
-/*
- * check_redirects() - checks the token (string) array for redirection and handles appropriately,
- *   if it is the first occurance of input or output and not the last token, then sets an integer
- *   flag corresponding to the redirection option, adds the next token to the redirection array,
- *   and sets appropriate locations in the token array to NULL
- *
- * Parameters:
- *  - num_tokens: an integer representing the number of tokens in the user input
- *  - redirect_input: an int* for the redirect input flag, 1 if true and 0 else
- *  - redirect_output: an int* for the redirect output flag, 1 if true and 0 else
- *  - redirect_output_append: an int* for the redirect append flag, 1 if true and 0 else
- *	- redirect_arr: an array of strings (char**) to hold all the tokens representing the location
- *                  of the redirection
- *	- alltok_arr: an array of strings (char**) holding all the tokens (including redirection)
- *                from the buffer
- *
- * Returns:
- *	- an integer, 1 if there was an error in parsing redirection, and 0 if redirects parsed
- *    correctly or there was no redirections
- */
-int check_redirects(int num_tokens, int* redirect_input, int* redirect_output,
-  int* redirect_output_append, char** redirect_arr, char** alltok_arr){
-  for(int i = 0; i < num_tokens; i++){
-    /* checks for "<" (i.e. red. input), checks first occurence, checks not last token, adds
-       next element to redirect_arr, and sets locations i and i + 1 to NULL */
-    if (!strcmp(alltok_arr[i], "<")){
-      if (*redirect_input){
-        fprintf(stderr, "ERROR - Can't have two input redirects on one line.\n");
-        return 1;
-      } else {
-        if (i == num_tokens - 1) {
-        fprintf(stderr, "ERROR - No redirection file specified.\n");
-        return 1;
-        }
-        *redirect_input = 1;
-        alltok_arr[i] = NULL;
-        redirect_arr[0] = alltok_arr[i + 1];
-        alltok_arr[i + 1] = NULL;
-        i++;
-        continue;
-      }
-    }
-    /* checks for ">" (i.e. red. output), checks first occurence, checks not last token, adds
-       next element to redirect_arr, and sets locations i and i + 1 to NULL */
-    if (!strcmp(alltok_arr[i], ">")){
-      if (*redirect_output || *redirect_output_append){
-        fprintf(stderr, "ERROR - Can't have two output redirects on one line.\n");
-        return 1;
-      } else {
-        if (i == num_tokens - 1) {
-          fprintf(stderr, "ERROR - No redirection file specified.\n");
-          return 1;
-        }
-        *redirect_output = 1;
-        alltok_arr[i] = NULL;
-        redirect_arr[1] = alltok_arr[i + 1];
-        alltok_arr[i + 1] = NULL;
-        i++;
-        continue;
-      }
-    }
-    /* checks for ">>" (i.e. red. append), checks first occurence, checks not last token, adds
-       next element to redirect_arr, and sets locations i and i + 1 to NULL */
-    if (!strcmp(alltok_arr[i], ">>")){
-      if (*redirect_output || *redirect_output_append){
-        fprintf(stderr, "ERROR - Can't have two output redirects on one line.\n");
-        return 1;
-      } else {
-        if (i == num_tokens - 1) {
-          fprintf(stderr, "ERROR - No redirection file specified.\n");
-          return 1;
-        }
-        *redirect_output_append = 1;
-        alltok_arr[i] = NULL;
-        redirect_arr[2] = alltok_arr[i + 1];
-        alltok_arr[i + 1] = NULL;
-        i++;
-        continue;
-      }
-    }
-  }
-  return 0;
-}
-
-/*
- * run_command() - performs the built-in functions cd, ln, rm, exit, jobs, bg, and fg as instructed
- *                 in the pdf, also error checks for bad input or if system calls did not return
- *                 correctly
- *
- * Parameters:
- *  - num_args: the number of arguments in the user input (not including redirections)
- *	- cmd_arg: an array of strings (char**) to hold all the tokens representing the arguments to
- *             the command (again not including redirection)
- *  - j_list: a job_list_t representing the list of current background jobs, contatining job ID,
- *            process ID, command, and state
- *
- * Returns:
- *	- an integer, 1 no built-in was found in the argument array, and 0 if the built-in was executed
- *    or at least attempted (and threw an error)
- */
-int run_command(int num_args, char** cmd_arg, job_list_t* j_list){
-  /* handles cd built-in */
-  if (!strcmp(cmd_arg[0], "cd")){
-    if (num_args >= 2){
-      int val1 = chdir(cmd_arg[1]);
-      if (val1 == -1){
-        perror("cd");
-        cleanup_job_list(j_list);
-        exit(1);
-      }
-      return 0;
-    } else{
-      fprintf(stderr, "cd: syntax error\n");
-      return 0;
-    }
-  }
-  /* handles ln built-in */
-  if (!strcmp(cmd_arg[0], "ln")){
-    if (num_args >= 3){
-      int val2 = link(cmd_arg[1], cmd_arg[2]);
-      if (val2 == -1){
-        perror("ln");
-        cleanup_job_list(j_list);
-        exit(1);
-      }
-      return 0;
-    } else{
-      fprintf(stderr, "ln: syntax error\n");
-      return 0;
-    }
-  }
-  /* handles rm built-in */
-  if (!strcmp(cmd_arg[0], "rm")){
-    if (num_args >= 2){
-      int val3 = unlink(cmd_arg[1]);
-      if (val3 == -1){
-        perror("rm");
-        cleanup_job_list(j_list);
-        exit(1);
-      }
-      return 0;
-    } else{
-      fprintf(stderr, "rm: syntax error\n");
-      return 0;
-    }
-  }
-  /* handles exit built-in */
-  if (!strcmp(cmd_arg[0], "exit")){
-    if (num_args >= 1){
-      cleanup_job_list(j_list);
-      exit(0);
-    }
-  }
-  /* handles jobs built-in */
-  if (!strcmp(cmd_arg[0], "jobs")){
-    if (num_args >= 1){
-      jobs(j_list);
-      return 0;
-    }
-  }
-  /* handles bg built-in */
-  if (!strcmp(cmd_arg[0], "bg")){
-    if (num_args >= 2){
-      if(*cmd_arg[1] == '%'){
-        /* checks if job exists */
-        char* job_num_char = cmd_arg[1];
-        job_num_char++;
-        int job_num_int = atoi(job_num_char);
-        pid_t pid = get_job_pid(j_list, job_num_int);
-        if (pid == -1){
-          fprintf(stderr, "job not found\n");
-          return 0;
-        } else {
-          /* sends SIGCONT to all processes in process group −pid */
-          if (kill(-pid, SIGCONT) == -1){
-            perror("kill");
-            cleanup_job_list(j_list);
-            exit(1);
-          }
-          update_job_pid(j_list, pid, _STATE_RUNNING);
-        }
-      } else {
-        fprintf(stderr, "bg: job input does not begin with %%\n");
-        return 0;
-      }
-      return 0;
-    } else {
-      fprintf(stderr, "bg: syntax error\n");
-      return 0;
-    }
-  }
-  /* handles fg built-in */
-  if (!strcmp(cmd_arg[0], "fg")){
-    if (num_args >= 2){
-      if(*cmd_arg[1] == '%'){
-        /* checks if job exists */
-        char* job_num_char = cmd_arg[1];
-        job_num_char++;
-        int job_num_int = atoi(job_num_char);
-        pid_t pid = get_job_pid(j_list, job_num_int);
-        if (pid == -1){
-          fprintf(stderr, "job not found\n");
-          return 0;
-        } else {
-          pid_t pid_shell = getpid();
-          /* sets control of window to the child to recieve user input */
-          if(tcsetpgrp(0, pid) == -1){
-            perror("tcsetpgrp");
-            cleanup_job_list(j_list);
-            exit(1);
-          }
-          /* sends SIGCONT to all processes in process group −pid */
-          if(kill(-pid, SIGCONT) == -1){
-            perror("kill");
-            cleanup_job_list(j_list);
-            exit(1);
-          }
-          update_job_pid(j_list, pid, _STATE_RUNNING);
-          /* calls waitpid on child process to examine change in state, and handle appropriately */
-          int wret, status;
-          wret = waitpid(pid, &status, WUNTRACED);
-          if (wret == -1){
-            fprintf(stderr, "ERROR - Child process did not execute properly.\n");
-            cleanup_job_list(j_list);
-            exit(1);
-          }
-          /* if child process terminates normally */
-          if (WIFEXITED(status)){
-            remove_job_jid(j_list, job_num_int);
-          }
-          /* if child process terminates with a signal */
-          if (WIFSIGNALED(status)){
-            int sig_exit_st = WTERMSIG(status);
-            remove_job_jid(j_list, job_num_int);
-            if (printf("[%d] (%d) terminated by signal %d\n", job_num_int, pid, sig_exit_st) < 0){
-              fprintf(stderr, "ERROR - Message did not print successfully.\n");
-              cleanup_job_list(j_list);
-              exit(1);
-            }
-          }
-          /* if child process stopped by a signal */
-          if (WIFSTOPPED(status)){
-            update_job_jid(j_list, job_num_int, _STATE_STOPPED);
-            int signal_num = WSTOPSIG(status);
-            if (printf("[%d] (%d) suspended by signal %d\n", job_num_int, pid, signal_num) < 0){
-              fprintf(stderr, "ERROR - Message did not print successfully.\n");
-              cleanup_job_list(j_list);
-              exit(1);
-            }
-          }
-          /* return control to the shell */
-          if(tcsetpgrp(0, pid_shell) == -1){
-            perror("tcsetpgrp");
-            cleanup_job_list(j_list);
-            exit(1);
-          }
-        }
-      } else {
-        fprintf(stderr, "fg: job input does not begin with %%\n");
-        return 0;
-      }
-      return 0;
-    } else {
-      fprintf(stderr, "fg: syntax error\n");
-      return 0;
-    }
-  }
-  /* returns 1 only if first comand line argument is not an implemented built-in */
-  return 1;
-}
-
-/*
- * run_child_process() - forks the parent process into a child proceess in order to run an
- *                       command, checking for redirection and opening and closing i/o files as
- *                       needed, execues command, and returns back to parent process
- *
- * Parameters:
- *  - redirect_input: an int for the redirect input flag, 1 if true and 0 else
- *  - redirect_output: an int* for the redirect output flag, 1 if true and 0 else
- *  - redirect_output_append: an int* for the redirect append flag, 1 if true and 0 else
- *	- redirect_arr: an array of strings (char**) to hold all the tokens representing the location
- *                  of the redirection
- *	- cmd_arg: an array of strings (char**) to hold all the tokens representing the arguments to
- *             the command (again not including redirection)
- *  - background_process: an int flag for if its is a background process, 1 if true and 0 else
- *  - j_list: a job_list_t representing the list of current background jobs, contatining job ID,
- *            process ID, command, and state
- *  - jid: an int* representing the current job id, which gets incremented by 1 on each new job
- *
- * Returns:
- *	- nothing (void) - executes the child process and returns
- */
-void run_child_process(int redirect_input, int redirect_output, int redirect_output_append,
-  char** redirect_arr, char** cmd_arg, int background_process, job_list_t* j_list, int* jid){
-  /* keeps pointer to full path, changes path pointer in command array to just the executable */
-  char* full_path = cmd_arg[0];
-  char* last_in_path = strrchr(cmd_arg[0], '/');
-  if (last_in_path != '\0'){
-    last_in_path++;
-  }
-  cmd_arg[0] = last_in_path;
-  /* forks child process */
-  pid_t pid_child;
-  pid_t pid_parent = getpid();
-  if ((pid_child = fork()) == 0){
-    /* set's process group id to be that of the calling process, transfer control if not
-       a background process */
-    pid_t actual_pid_child = getpid();
-    if (setpgid(actual_pid_child, actual_pid_child) == -1){
-      perror("setpgid");
-      cleanup_job_list(j_list);
-      exit(1);
-    }
-    if (!background_process){
-      if (tcsetpgrp(0, actual_pid_child) == -1){
-        perror("tcsetpgrp");
-        cleanup_job_list(j_list);
-        exit(1);
-      }
-    }
-    /* sets the signal ignores back to default handling in the child */
-    if (signal(SIGINT, SIG_DFL) == SIG_ERR){
-      perror("signal");
-      cleanup_job_list(j_list);
-      exit(1);
-    }
-    if (signal(SIGTSTP, SIG_DFL) == SIG_ERR){
-      perror("signal");
-      cleanup_job_list(j_list);
-      exit(1);
-    }
-    if (signal(SIGQUIT, SIG_DFL) == SIG_ERR){
-      perror("signal");
-      cleanup_job_list(j_list);
-      exit(1);
-    }
-    if (signal(SIGTTOU, SIG_DFL) == SIG_ERR){
-      perror("signal");
-      cleanup_job_list(j_list);
-      exit(1);
-    }
-    /* checks if "<" used, handles appropriately */
-    if(redirect_input){
-       if (close(0) == -1){
-         perror("close");
-         cleanup_job_list(j_list);
-         exit(1);
-       }
-       if (open(redirect_arr[0], O_RDONLY) == -1){
-         perror("open");
-         cleanup_job_list(j_list);
-         exit(1);
-       }
-    }
-    /* checks if ">" used, handles appropriately */
-    if(redirect_output){
-      if (close(1) == -1){
-        perror("close");
-        cleanup_job_list(j_list);
-        exit(1);
-      }
-      if (open(redirect_arr[1], O_WRONLY | O_CREAT | O_TRUNC, 0666) == -1){
-        perror("open");
-        cleanup_job_list(j_list);
-        exit(1);
-      }
-    }
-    /* checks if ">>" used, handles appropriately */
-    if(redirect_output_append){
-      if (close(1) == -1){
-        perror("close");
-        cleanup_job_list(j_list);
-        exit(1);
-      }
-      if (open(redirect_arr[2], O_WRONLY | O_CREAT | O_APPEND, 0666) == -1){
-        perror("open");
-        cleanup_job_list(j_list);
-        exit(1);
-      }
-    }
-    /* executes child process replacing old stack */
-    execv(full_path, cmd_arg);
-    /* we won't get here unless execv failed */
-    perror("execv");
-    cleanup_job_list(j_list);
-    exit(1);
-  }
-  /* adds job to jobs list if background process and prints */
-  if (background_process) {
-    *jid = *jid + 1;
-    add_job(j_list, *jid, pid_child, _STATE_RUNNING, full_path);
-    if (printf("[%d] (%d)\n", *jid, pid_child) < 0){
-      fprintf(stderr, "ERROR - Message did not print successfully.\n");
-      cleanup_job_list(j_list);
-      exit(1);
-    }
-    if (tcsetpgrp(0, pid_parent) == -1){
-      perror("tcsetpgrp");
-      cleanup_job_list(j_list);
-      exit(1);
-    }
-  } else {
-    /* if not waits for changes in status */
-    int wret, status;
-    wret = waitpid(pid_child, &status, WUNTRACED);
-    if (wret == -1){
-      fprintf(stderr, "ERROR - Child process did not execute properly.\n");
-      cleanup_job_list(j_list);
-      exit(1);
-    }
-    /* if process stopped by a signal */
-    if (WIFSTOPPED(status)){
-      int signal_num = WSTOPSIG(status);
-      *jid = *jid + 1;
-      add_job(j_list, *jid, pid_child, _STATE_STOPPED, full_path);
-      if (printf("[%d] (%d) suspended by signal %d\n", *jid, pid_child, signal_num) < 0){
-        fprintf(stderr, "ERROR - Message did not print successfully.\n");
-        cleanup_job_list(j_list);
-        exit(1);
-      }
-    }
-    /* if process terminated with a signal */
-    if (WIFSIGNALED(status)){
-      int signal_num = WTERMSIG(status);
-      *jid = *jid + 1;
-      if (printf("[%d] (%d) terminated by signal %d\n", *jid, pid_child, signal_num) < 0){
-        fprintf(stderr, "ERROR - Message did not print successfully.\n");
-        cleanup_job_list(j_list);
-        exit(1);
-      }
-    }
-    /* transfer control back to shell */
-    if (tcsetpgrp(0, pid_parent) == -1){
-      perror("tcsetpgrp");
-      cleanup_job_list(j_list);
-      exit(1);
-    }
-  }
-}
-
-/*
- * reap() - reaps the job list by iterating through jobs and checking for changes in
- *          state or termination
- *
- * Parameters:
- *  - j_list: a job_list_t representing the list of current background jobs, contatining job ID,
- *            process ID, command, and state
- *
- * Returns:
- *	- nothing (void) - reaps the job list and returns
- */
-void reap(job_list_t* j_list){
-  pid_t next_pid = get_next_pid(j_list);
-  /* iterates through job list with while loop */
-  while(next_pid != -1){
-    /* waits for changes in status */
-    int job_id = get_job_jid(j_list, next_pid);
-    int wret, status;
-    /* note: if wret = 0 then status has not changed, and we move onto next job */
-    if ((wret = waitpid(next_pid, &status, WNOHANG | WUNTRACED | WCONTINUED)) > 0){
-      /* if process exits normally */
-      if (WIFEXITED(status)){
-        int exit_st = WEXITSTATUS(status);
-        remove_job_jid(j_list, job_id);
-        if (printf("[%d] (%d) terminated with exit status %d\n", job_id, next_pid, exit_st) < 0){
-          fprintf(stderr, "ERROR - Message did not print successfully.\n");
-          cleanup_job_list(j_list);
-          exit(1);
-        }
-      }
-      /* if process terminated with a signal */
-      if (WIFSIGNALED(status)){
-        int sig_exit_status = WTERMSIG(status);
-        remove_job_jid(j_list, job_id);
-        if (printf("[%d] (%d) terminated by signal %d\n", job_id, next_pid, sig_exit_status) < 0){
-          fprintf(stderr, "ERROR - Message did not print successfully.\n");
-          cleanup_job_list(j_list);
-          exit(1);
-        }
-      }
-      /* if process stopped by a signal */
-      if (WIFSTOPPED(status)){
-        update_job_jid(j_list, job_id, _STATE_STOPPED);
-        int signal_num = WSTOPSIG(status);
-        if (printf("[%d] (%d) suspended by signal %d\n", job_id, next_pid, signal_num) < 0){
-          fprintf(stderr, "ERROR - Message did not print successfully.\n");
-          cleanup_job_list(j_list);
-          exit(1);
-        }
-      }
-      /* if process continued by a signal */
-      if (WIFCONTINUED(status)){
-        update_job_jid(j_list, job_id, _STATE_RUNNING);
-        if (printf("[%d] (%d) resumed\n", job_id, next_pid) < 0){
-          fprintf(stderr, "ERROR - Message did not print successfully.\n");
-          cleanup_job_list(j_list);
-          exit(1);
-        }
-      }
-    } else {
-      if (wret == -1){
-        fprintf(stderr, "ERROR - Child process did not execute properly.\n");
-        cleanup_job_list(j_list);
-        exit(1);
-      }
-    }
-    next_pid = get_next_pid(j_list);
-  }
-}
-
-/* executes shell */
-int main() {
-  /* instantiates job list and job id */
-  job_list_t* j_list = init_job_list();
-  int jid = 0;
-  /* ignore these signals in the shell */
-  if (signal(SIGINT, SIG_IGN) == SIG_ERR){
-    perror("signal");
-    cleanup_job_list(j_list);
-    exit(1);
-  }
-  if (signal(SIGTSTP, SIG_IGN) == SIG_ERR){
-    perror("signal");
-    cleanup_job_list(j_list);
-    exit(1);
-  }
-  if (signal(SIGQUIT, SIG_IGN) == SIG_ERR){
-    perror("signal");
-    cleanup_job_list(j_list);
-    exit(1);
-  }
-  if (signal(SIGTTOU, SIG_IGN) == SIG_ERR){
-    perror("signal");
-    cleanup_job_list(j_list);
-    exit(1);
-  }
-  /* create REPL loop */
-  while(1){
-    /* reap the jobs list */
-    reap(j_list);
-    /* instantiates buffer */
-    char buffer[1024];
-    /* prompts user for input */
-    #ifdef PROMPT
-    if (printf("33sh> ") < 0){
-      fprintf(stderr, "ERROR - Prompt did not print successfully.\n");
-      cleanup_job_list(j_list);
-      exit(1);
-    }
-    fflush(stdout);
-    #endif
-    /* reads in user input */
-    ssize_t count = read(STDIN_FILENO, buffer, 1024);
-    buffer[count - 1] = '\0';
-    if (count < 0){
-      fprintf(stderr, "ERROR - Input not read successfully.\n");
-      cleanup_job_list(j_list);
-      exit(1);
-    }
-    /* if user types 'enter', and then count is exactly 1 */
-    if (count == 1){
-      continue;
-    }
-    /* if user types ctrl-D */
-    if (!count){
-      cleanup_job_list(j_list);
-      exit(0);
-    }
-    /* figures out number of tokens in input, if just whitespace restarts loop */
-    int num_tokens = count_tokens(buffer);
-    if (!num_tokens){
-      continue;
-    }
-    /* stores all tokens in an array */
-    char* alltok_arr[num_tokens];
-    tokenize(alltok_arr, buffer);
-    /* sets background flag if last token is & */
-    int background_process = 0;
-    if (!strcmp(alltok_arr[num_tokens-1], "&")){
-      background_process = 1;
-      alltok_arr[num_tokens-1] = '\0';
-      num_tokens--;
-    }
-    /* error checking for no command */
-    if ((*alltok_arr[0] == '<' || *alltok_arr[0] == '>') && num_tokens <= 2){
-      fprintf(stderr, "ERROR - No command.\n");
-      continue;
-    }
-    /* instantiates redirection int flags and array for filenames */
-    int redirect_input = 0;
-    int redirect_output = 0;
-    int redirect_output_append = 0;
-    char* redirect_arr[3];
-    /* sets int flag pointers to pass into redirect function */
-    int* r_i = &redirect_input;
-    int* r_o = &redirect_output;
-    int* r_oa = &redirect_output_append;
-    /* checks for redirects */
-    int ch_red_error = check_redirects(num_tokens, r_i, r_o, r_oa, redirect_arr, alltok_arr);
-    if (ch_red_error){
-      continue;
-    }
-    /* finds number of arguments without redirections */
-    int num_args = num_tokens;
-    if (redirect_input){
-      num_args -= 2;
-    }
-    if (redirect_output || redirect_output_append){
-      num_args -= 2;
-    }
-    /* create command arguments array */
-    char* cmd_arg[num_args + 1];
-    int j = 0;
-    for(int i = 0; i < num_tokens; i++){
-      if (alltok_arr[i] != NULL){
-        cmd_arg[j] = alltok_arr[i];
-        j++;
-      }
-    }
-    cmd_arg[num_args] = '\0';
-    /* parse for builtins and execute if exists */
-    int val = run_command(num_args, cmd_arg, j_list);
-    if (!val){
-      continue;
-    } else {
-      /* no builtins, then try to execute shild process */
-      run_child_process(redirect_input, redirect_output, redirect_output_append,
-        redirect_arr, cmd_arg, background_process, j_list, &jid);
-    }
-  }
-  return 0;
-}
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio_ext.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <time.h>
+#include "jobs.h"
+#include "launch.h"
+#include "pathcache.h"
+#include "linereader.h"
+#include "arena.h"
+#include "lexer.h"
+#include "parser.h"
+#include "trace.h"
+#include "builtins.h"
+#include "queue.h"
+#include "placement.h"
+#include "zygote.h"
+#include "server.h"
+#include "cache.h"
+#include "glob.h"
+
+/* what the time prefix measures of a job, filled in by wait_job(), waited is 1 once a job has
+   been waited for, and stopped is 1 if it stopped instead of finishing */
+typedef struct timing {
+  int waited;
+  int stopped;
+  struct rusage usage;
+} timing_t;
+
+/* 1 if the shell reads its commands from a terminal, which it then hands to each foreground job,
+   0 with -c or for a script or a pipe, when it does no terminal control at all */
+static int interactive = 0;
+/* the exit status of the last command run, which the shell exits with */
+static int last_status = 0;
+/* the commands waiting to be started by the shell as background jobs (see submit), NULL until
+   the first one is submitted */
+static job_queue_t* queue = NULL;
+/* with --server, the client session being served (see serve()), whose socket is then the shell's
+   standard output and error and whose job list, last status and queue are in use, NULL else */
+static session_t* session = NULL;
+/* the launch of the shell builtin being run, for its redirections, NULL when none is */
+static launch_t* builtin_stage = NULL;
+/* the reader of the shell's own input while a builtin runs, for one that reads its standard
+   input to read the lines after its own, NULL with -c or --server */
+static line_reader_t* builtin_reader = NULL;
+
+/*
+ * check_redirects() - checks the token array for redirection and handles appropriately,
+ *   if it is the first occurance of input or output and followed by a word, then sets an integer
+ *   flag corresponding to the redirection option, adds the word to the redirection array,
+ *   and sets the word's text in the token array to NULL
+ *
+ * Parameters:
+ *  - num_tokens: an integer representing the number of tokens in the user input
+ *  - redirect_input: an int* for the redirect input flag, 1 if true and 0 else
+ *  - redirect_output: an int* for the redirect output flag, 1 if true and 0 else
+ *  - redirect_output_append: an int* for the redirect append flag, 1 if true and 0 else
+ *	- redirect_arr: an array of strings (char**) to hold all the tokens representing the location
+ *                  of the redirection
+ *	- tokens: an array of token_t holding all the tokens (including redirection) from the
+ *            buffer
+ *
+ * Returns:
+ *	- an integer, 1 if there was an error in parsing redirection, and 0 if redirects parsed
+ *    correctly or there was no redirections
+ */
+int check_redirects(int num_tokens, int* redirect_input, int* redirect_output,
+  int* redirect_output_append, char** redirect_arr, token_t* tokens){
+  for(int i = 0; i < num_tokens; i++){
+    /* checks for "<" (i.e. red. input), checks first occurence, checks a word follows, adds
+       it to redirect_arr, and sets its text to NULL */
+    if (tokens[i].type == TOKEN_INPUT){
+      if (*redirect_input){
+        fprintf(stderr, "ERROR - Can't have two input redirects on one line.\n");
+        return 1;
+      } else {
+        if (i == num_tokens - 1 || tokens[i + 1].type != TOKEN_WORD) {
+        fprintf(stderr, "ERROR - No redirection file specified.\n");
+        return 1;
+        }
+        *redirect_input = 1;
+        redirect_arr[0] = tokens[i + 1].text;
+        tokens[i + 1].text = NULL;
+        i++;
+        continue;
+      }
+    }
+    /* checks for ">" (i.e. red. output), checks first occurence, checks a word follows, adds
+       it to redirect_arr, and sets its text to NULL */
+    if (tokens[i].type == TOKEN_OUTPUT){
+      if (*redirect_output || *redirect_output_append){
+        fprintf(stderr, "ERROR - Can't have two output redirects on one line.\n");
+        return 1;
+      } else {
+        if (i == num_tokens - 1 || tokens[i + 1].type != TOKEN_WORD) {
+          fprintf(stderr, "ERROR - No redirection file specified.\n");
+          return 1;
+        }
+        *redirect_output = 1;
+        redirect_arr[1] = tokens[i + 1].text;
+        tokens[i + 1].text = NULL;
+        i++;
+        continue;
+      }
+    }
+    /* checks for ">>" (i.e. red. append), checks first occurence, checks a word follows, adds
+       it to redirect_arr, and sets its text to NULL */
+    if (tokens[i].type == TOKEN_APPEND){
+      if (*redirect_output || *redirect_output_append){
+        fprintf(stderr, "ERROR - Can't have two output redirects on one line.\n");
+        return 1;
+      } else {
+        if (i == num_tokens - 1 || tokens[i + 1].type != TOKEN_WORD) {
+          fprintf(stderr, "ERROR - No redirection file specified.\n");
+          return 1;
+        }
+        *redirect_output_append = 1;
+        redirect_arr[2] = tokens[i + 1].text;
+        tokens[i + 1].text = NULL;
+        i++;
+        continue;
+      }
+    }
+  }
+  return 0;
+}
+
+/*
+ * waitid_usage() - waitid(), but also returning the resource usage of a child it reaps, which
+ *                  the system call supports and the glibc wrapper leaves out
+ *
+ * Parameters:
+ *  - idtype, id, info, options: as for waitid()
+ *  - usage: a struct rusage* filled in for a child that exited (NULL to ignore)
+ *
+ * Returns:
+ *	- an integer, 0 on success, -1 on failure with errno set
+ */
+int waitid_usage(idtype_t idtype, id_t id, siginfo_t* info, int options, struct rusage* usage){
+  return (int) syscall(SYS_waitid, idtype, id, info, options, usage);
+}
+
+/*
+ * trace_status() - writes a trace event for a change in a child's state (see trace.c)
+ *
+ * Parameters:
+ *  - pid: the pid of the child
+ *  - status: the change, as a status from waitpid()
+ *
+ * Returns:
+ *	- nothing (void) - writes the event and returns
+ */
+void trace_status(pid_t pid, int status){
+  char detail[32];
+  if (WIFEXITED(status)){
+    snprintf(detail, sizeof(detail), "status %d", WEXITSTATUS(status));
+    trace_instant("exited", pid, detail);
+  } else if (WIFSIGNALED(status)){
+    snprintf(detail, sizeof(detail), "signal %d", WTERMSIG(status));
+    trace_instant("signaled", pid, detail);
+  } else if (WIFSTOPPED(status)){
+    snprintf(detail, sizeof(detail), "signal %d", WSTOPSIG(status));
+    trace_instant("stopped", pid, detail);
+  } else {
+    trace_instant("continued", pid, NULL);
+  }
+}
+
+/*
+ * give_terminal() - makes a process group the foreground group of the terminal, if the shell is
+ *                   interactive (otherwise there is no terminal to hand over, and no system call
+ *                   is made)
+ *
+ * Parameters:
+ *  - pgid: the process group, the shell's own to take the terminal back
+ *  - j_list: a job_list_t representing the list of current background jobs, cleaned up if the
+ *            shell has to exit
+ *
+ * Returns:
+ *	- nothing (void)
+ */
+void give_terminal(pid_t pgid, job_list_t* j_list){
+  if (!interactive){
+    return;
+  }
+  if (tcsetpgrp(STDIN_FILENO, pgid) == -1){
+    perror("tcsetpgrp");
+    cleanup_job_list(j_list);
+    exit(1);
+  }
+  if (TRACE_ON){
+    trace_instant("tcsetpgrp", pgid, "shell");
+  }
+}
+
+/* removes a job that finished with status (as from waitpid()), giving back the CPUs it was placed
+   on, and if the queue started it, marks its entry finished so another can start */
+void finish_job(job_list_t* j_list, int job_id, int status){
+  /* the CPUs it held are free for the next job placed (see placement.h) */
+  const cpu_set_t* cpus = get_job_cpus(j_list, job_id);
+  if (cpus != NULL){
+    release_cpus(cpus);
+  }
+  if (queue != NULL){
+    finish_queued(queue, job_id, status);
+  }
+  remove_job_jid(j_list, job_id);
+}
+
+/* picks the CPUs of a new background job by the placement policy (see placement.h) into cpus,
+   and points the stage at them, returns 1 if the job was placed, 0 else */
+int place_stage(launch_t* stage, cpu_set_t* cpus){
+  int node;
+  if (place_job(cpus, &node) == -1){
+    return 0;
+  }
+  stage->cpus = cpus;
+  stage->node = node;
+  return 1;
+}
+
+/* records the CPUs a job's stage was placed on in the job list, where jobs -l shows them, until
+   finish_job() gives them back */
+void hold_job_cpus(job_list_t* j_list, int job_id, launch_t* stage){
+  if (stage->cpus != NULL && set_job_cpus(j_list, job_id, stage->cpus, stage->node) == 0){
+    hold_cpus(stage->cpus);
+  }
+}
+
+/* converts a status from wait() into an exit status as shells give it, that of a job killed or
+   stopped by a signal being 128 plus the signal's number */
+int exit_status(int status){
+  if (WIFSIGNALED(status)){
+    return 128 + WTERMSIG(status);
+  }
+  if (WIFSTOPPED(status)){
+    return 128 + WSTOPSIG(status);
+  }
+  return WEXITSTATUS(status);
+}
+
+/*
+ * wait_job() - waits for a job in the foreground, until every one of its processes has exited
+ *              or it is stopped, updating the job list accordingly, and with wait4() so the
+ *              job's resource usage is collected at no extra cost
+ *
+ * Parameters:
+ *  - j_list: a job_list_t representing the list of current background jobs, contatining job ID,
+ *            process ID, command, and state
+ *  - job_id: the job id of the job
+ *  - timing: a timing_t* to fill in with the job's resource usage, NULL if it is not timed
+ *
+ * Returns:
+ *	- an integer, the status (as from waitpid()) of the job's last process if the job exited, in
+ *    which case it has been removed from the list, or of the process that stopped if it stopped
+ */
+int wait_job(job_list_t* j_list, int job_id, timing_t* timing){
+  pid_t pgid = get_job_pid(j_list, job_id);
+  double start = TRACE_ON ? trace_now() : 0;
+  if (timing != NULL){
+    timing->waited = 1;
+    timing->stopped = 0;
+  }
+  while(1){
+    int status;
+    struct rusage usage;
+    pid_t pid = wait4(-pgid, &status, WUNTRACED, &usage);
+    if (pid == -1){
+      if (errno == EINTR){
+        continue;
+      }
+      /* every process was already reaped, so there is nothing left to wait for */
+      if (errno == ECHILD){
+        status = get_job_status(j_list, job_id);
+        if (timing != NULL){
+          get_job_usage(j_list, job_id, &timing->usage);
+        }
+        status = status == -1 ? 0 : status;
+        finish_job(j_list, job_id, status);
+        if (TRACE_ON){
+          trace_span("wait", start, pgid, "done");
+        }
+        return status;
+      }
+      fprintf(stderr, "ERROR - Child process did not execute properly.\n");
+      cleanup_job_list(j_list);
+      exit(1);
+    }
+    if (TRACE_ON){
+      trace_status(pid, status);
+    }
+    /* a stop of any process stops the whole job, the others report theirs later */
+    if (WIFSTOPPED(status)){
+      update_job_jid(j_list, job_id, _STATE_STOPPED);
+      if (timing != NULL){
+        timing->stopped = 1;
+      }
+      if (TRACE_ON){
+        trace_span("wait", start, pgid, "stopped");
+      }
+      return status;
+    }
+    if (reap_job_process(j_list, pid, status, &usage) == 0){
+      status = get_job_status(j_list, job_id);
+      if (timing != NULL){
+        get_job_usage(j_list, job_id, &timing->usage);
+      }
+      finish_job(j_list, job_id, status);
+      if (TRACE_ON){
+        trace_span("wait", start, pgid, "done");
+      }
+      return status;
+    }
+  }
+}
+
+/* handles cd built-in */
+static int builtin_cd(int num_args, char** cmd_arg, job_list_t* j_list, int* jid, timing_t* timing){
+  (void) jid;
+  (void) timing;
+  if (num_args >= 2){
+    int val1 = chdir(cmd_arg[1]);
+    if (val1 == -1){
+      perror("cd");
+      /* a session only fails its own command, the server goes on */
+      if (session != NULL){
+        return 1;
+      }
+      cleanup_job_list(j_list);
+      exit(1);
+    }
+    /* a session keeps its working directory for its next line */
+    if (session != NULL){
+      int cwd = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+      if (cwd != -1){
+        close(session->cwd);
+        session->cwd = cwd;
+      }
+    }
+    return 0;
+  } else{
+    fprintf(stderr, "cd: syntax error\n");
+    return 1;
+  }
+}
+
+/* handles ln built-in */
+static int builtin_ln(int num_args, char** cmd_arg, job_list_t* j_list, int* jid, timing_t* timing){
+  (void) jid;
+  (void) timing;
+  if (num_args >= 3){
+    int val2 = link(cmd_arg[1], cmd_arg[2]);
+    if (val2 == -1){
+      perror("ln");
+      if (session != NULL){
+        return 1;
+      }
+      cleanup_job_list(j_list);
+      exit(1);
+    }
+    return 0;
+  } else{
+    fprintf(stderr, "ln: syntax error\n");
+    return 1;
+  }
+}
+
+/* handles rm built-in */
+static int builtin_rm(int num_args, char** cmd_arg, job_list_t* j_list, int* jid, timing_t* timing){
+  (void) jid;
+  (void) timing;
+  if (num_args >= 2){
+    int val3 = unlink(cmd_arg[1]);
+    if (val3 == -1){
+      perror("rm");
+      if (session != NULL){
+        return 1;
+      }
+      cleanup_job_list(j_list);
+      exit(1);
+    }
+    return 0;
+  } else{
+    fprintf(stderr, "rm: syntax error\n");
+    return 1;
+  }
+}
+
+/* handles exit built-in, exit [status] */
+static int builtin_exit(int num_args, char** cmd_arg, job_list_t* j_list, int* jid,
+  timing_t* timing){
+  (void) jid;
+  (void) timing;
+  /* exits with the given status, or that of the last command */
+  int status = num_args >= 2 ? atoi(cmd_arg[1]) & 0xff : last_status;
+  /* a session's exit ends only the session, which is closed once its jobs are done */
+  if (session != NULL){
+    session->input_done = 1;
+    cleanup_job_queue(queue);
+    queue = NULL;
+    return status;
+  }
+  cleanup_job_queue(queue);
+  cleanup_job_list(j_list);
+  cleanup_path_cache();
+  exit(status);
+}
+
+/* handles hash built-in, which shows (no arguments), resets (-r) or fills the PATH cache */
+static int builtin_hash(int num_args, char** cmd_arg, job_list_t* j_list, int* jid,
+  timing_t* timing){
+  (void) jid;
+  (void) j_list;
+  (void) timing;
+  if (num_args == 1){
+    print_path_cache();
+  } else if (!strcmp(cmd_arg[1], "-r")){
+    reset_path_cache();
+  } else {
+    for (int i = 1; i < num_args; i++){
+      if (strchr(cmd_arg[i], '/') == NULL && resolve_command(cmd_arg[i]) == NULL){
+        fprintf(stderr, "hash: %s: not found\n", cmd_arg[i]);
+      }
+    }
+  }
+  return 0;
+}
+
+/* handles pipesize built-in, which shows or sets the capacity of the pipes between pipeline
+   stages (F_SETPIPE_SZ), 0 meaning the system default */
+static int builtin_pipesize(int num_args, char** cmd_arg, job_list_t* j_list, int* jid,
+  timing_t* timing){
+  (void) jid;
+  (void) j_list;
+  (void) timing;
+  if (num_args == 1){
+    int size = get_pipe_size();
+    if (size){
+      printf("%d\n", size);
+    } else {
+      printf("default\n");
+    }
+  } else {
+    char* end;
+    long size = strtol(cmd_arg[1], &end, 10);
+    if (*end == 'k' || *end == 'K'){
+      size *= 1024;
+      end++;
+    } else if (*end == 'm' || *end == 'M'){
+      size *= 1024 * 1024;
+      end++;
+    }
+    if (end == cmd_arg[1] || *end != '\0' || size < 0 || size > INT32_MAX){
+      fprintf(stderr, "pipesize: invalid size\n");
+    } else if (set_pipe_size((int) size) == -1){
+      perror("pipesize");
+    }
+  }
+  return 0;
+}
+
+/* handles jobs built-in, the queue's running commands being jobs like any other */
+static int builtin_jobs(int num_args, char** cmd_arg, job_list_t* j_list, int* jid,
+  timing_t* timing){
+  (void) jid;
+  (void) timing;
+  /* jobs -l also shows each job's resource usage */
+  if (num_args >= 2 && !strcmp(cmd_arg[1], "-l")){
+    jobs_long(j_list);
+  } else {
+    jobs(j_list);
+  }
+  /* then the submitted commands not started yet, and the ones finished since the last time */
+  if (queue != NULL){
+    print_queue(queue);
+  }
+  return 0;
+}
+
+/* handles bg built-in */
+static int builtin_bg(int num_args, char** cmd_arg, job_list_t* j_list, int* jid, timing_t* timing){
+  (void) jid;
+  (void) timing;
+  if (num_args >= 2){
+    if(*cmd_arg[1] == '%'){
+      /* checks if job exists */
+      char* job_num_char = cmd_arg[1];
+      job_num_char++;
+      int job_num_int = atoi(job_num_char);
+      pid_t pid = get_job_pid(j_list, job_num_int);
+      if (pid == -1){
+        fprintf(stderr, "job not found\n");
+        return 1;
+      } else {
+        /* sends SIGCONT to all processes in process group −pid, through the job's pidfd */
+        if (signal_job(j_list, job_num_int, SIGCONT) == -1){
+          perror("kill");
+          if (session != NULL){
+            return 1;
+          }
+          cleanup_job_list(j_list);
+          exit(1);
+        }
+        update_job_pid(j_list, pid, _STATE_RUNNING);
+      }
+    } else {
+      fprintf(stderr, "bg: job input does not begin with %%\n");
+      return 1;
+    }
+    return 0;
+  } else {
+    fprintf(stderr, "bg: syntax error\n");
+    return 1;
+  }
+}
+
+/* handles fg built-in */
+static int builtin_fg(int num_args, char** cmd_arg, job_list_t* j_list, int* jid, timing_t* timing){
+  (void) jid;
+  if (num_args >= 2){
+    if(*cmd_arg[1] == '%'){
+      /* checks if job exists */
+      char* job_num_char = cmd_arg[1];
+      job_num_char++;
+      int job_num_int = atoi(job_num_char);
+      pid_t pid = get_job_pid(j_list, job_num_int);
+      if (pid == -1){
+        fprintf(stderr, "job not found\n");
+        return 1;
+      } else {
+        pid_t pid_shell = getpid();
+        /* sets control of window to the child to recieve user input */
+        give_terminal(pid, j_list);
+        /* sends SIGCONT to all processes in process group −pid, through the job's pidfd */
+        if(signal_job(j_list, job_num_int, SIGCONT) == -1){
+          perror("kill");
+          if (session != NULL){
+            return 1;
+          }
+          cleanup_job_list(j_list);
+          exit(1);
+        }
+        update_job_pid(j_list, pid, _STATE_RUNNING);
+        /* a session waits for it as for any foreground job, parked while the server's loop goes
+           on, and report_change() prints what becomes of it (see run_child_process()) */
+        if (session != NULL){
+          session->waiting_jid = job_num_int;
+          return 0;
+        }
+        /* waits for every process of the job to exit, or for it to stop, and handles the
+           status appropriately (wait_job() already removed or updated the job) */
+        int status = wait_job(j_list, job_num_int, timing);
+        /* if child process terminates with a signal */
+        if (WIFSIGNALED(status)){
+          int sig_exit_st = WTERMSIG(status);
+          if (printf("[%d] (%d) terminated by signal %d\n", job_num_int, pid, sig_exit_st) < 0){
+            fprintf(stderr, "ERROR - Message did not print successfully.\n");
+            cleanup_job_list(j_list);
+            exit(1);
+          }
+        }
+        /* if child process stopped by a signal */
+        if (WIFSTOPPED(status)){
+          int signal_num = WSTOPSIG(status);
+          if (printf("[%d] (%d) suspended by signal %d\n", job_num_int, pid, signal_num) < 0){
+            fprintf(stderr, "ERROR - Message did not print successfully.\n");
+            cleanup_job_list(j_list);
+            exit(1);
+          }
+        }
+        /* return control to the shell */
+        give_terminal(pid_shell, j_list);
+        return exit_status(status);
+      }
+    } else {
+      fprintf(stderr, "fg: job input does not begin with %%\n");
+      return 1;
+    }
+  } else {
+    fprintf(stderr, "fg: syntax error\n");
+    return 1;
+  }
+}
+
+/* defined below, with the rest of running jobs */
+pid_t start_stage(launch_t* stage);
+int report_change(job_list_t* j_list, pid_t pid, int status, struct rusage* usage);
+int run_child_process(launch_t* stages, int num_stages, int background_process,
+  job_list_t* j_list, int* jid, timing_t* timing);
+
+/* 1 (after saying so) in a server session, where a builtin that waits for jobs of its own would
+   keep the server's loop, and so every other session, waiting too (see serve()), 0 else */
+static int refused_in_session(const char* name){
+  if (session == NULL){
+    return 0;
+  }
+  fprintf(stderr, "%s: not available in a server session\n", name);
+  return 1;
+}
+
+/* set by a SIGINT while parallel waits, after which it starts no more jobs */
+static volatile sig_atomic_t parallel_interrupted = 0;
+
+static void parallel_interrupt(int sig){
+  (void) sig;
+  parallel_interrupted = 1;
+}
+
+/* the jobs parallel (or batch) has running, slot i being job id base_jid + 1 + i (pid 0 if free),
+   status being the exit status of the jobs that have exited as batch gives it (see
+   batch_status()) */
+typedef struct parallel_jobs {
+  pid_t* pids;
+  int num_slots;
+  int running;
+  int base_jid;
+  long run;
+  long failed;
+  int status;
+} parallel_jobs_t;
+
+/*
+ * batch_status() - folds the status of one more job into an exit status as xargs gives it: 0 if
+ *                  every job succeeded, 123 if one exited with another status, 124 if one exited
+ *                  with 255, 125 if one was killed by a signal, and 126 or 127 if one could not
+ *                  be started, the highest of these winning
+ *
+ * Parameters:
+ *  - so_far: the exit status of the jobs before
+ *  - status: a status from wait(), or -126 or -127 for a job that could not be started
+ *
+ * Returns:
+ *	- an integer, the exit status of them all
+ */
+static int batch_status(int so_far, int status){
+  int folded = 0;
+  if (status < 0){
+    folded = -status;
+  } else if (WIFSIGNALED(status)){
+    folded = 125;
+  } else if (WEXITSTATUS(status) == 255){
+    folded = 124;
+  } else if (WEXITSTATUS(status) != 0){
+    folded = 123;
+  }
+  return folded > so_far ? folded : so_far;
+}
+
+/* takes a job that was started into a free slot of jobs, and the jobs list */
+static void parallel_add(parallel_jobs_t* jobs, job_list_t* j_list, pid_t pid, launch_t* stage,
+  char* command){
+  int slot = 0;
+  while(jobs->pids[slot] != 0){
+    slot++;
+  }
+  jobs->pids[slot] = pid;
+  jobs->running++;
+  add_job(j_list, jobs->base_jid + 1 + slot, pid, _STATE_RUNNING, command);
+  hold_job_cpus(j_list, jobs->base_jid + 1 + slot, stage);
+}
+
+/* catches a ^C rather than ignoring it while parallel's (or batch's) jobs run, to stop them
+   (they are in process groups of their own, so it only reaches the shell), saving how it was
+   handled before in saved */
+static void parallel_catch(struct sigaction* saved){
+  parallel_interrupted = 0;
+  if (interactive){
+    struct sigaction interrupt;
+    memset(&interrupt, 0, sizeof(interrupt));
+    interrupt.sa_handler = parallel_interrupt;
+    sigemptyset(&interrupt.sa_mask);
+    sigaction(SIGINT, &interrupt, saved);
+  }
+}
+
+/* handles a ^C as before parallel_catch() again, returns 1 if one came meanwhile, 0 else */
+static int parallel_release(struct sigaction* saved){
+  if (interactive){
+    sigaction(SIGINT, saved, NULL);
+  }
+  int interrupted = parallel_interrupted != 0;
+  parallel_interrupted = 0;
+  return interrupted;
+}
+
+/*
+ * parallel_input() - gets the next input for parallel, from its arguments after ":::" or else
+ *                    a line at a time from standard input (empty lines are skipped)
+ *
+ * Parameters:
+ *  - inputs: the inputs after ":::", NULL to read standard input
+ *  - num_inputs: the number of inputs
+ *  - next: an int* to the index of the next input, incremented
+ *  - reader: the line_reader_t* of the shell's own input if that is standard input, which the
+ *            lines are then read through, so the shell goes on after the last one, NULL else
+ *  - input: a FILE* for standard input if it is read otherwise, NULL else
+ *  - line, line_size: a buffer for getline(), grown as needed
+ *
+ * Returns:
+ *	- the input, or NULL once there are no more
+ */
+static char* parallel_input(char** inputs, int num_inputs, int* next, line_reader_t* reader,
+  FILE* input, char** line, size_t* line_size){
+  if (reader != NULL){
+    char* value;
+    size_t value_length;
+    while((value = read_line(reader, &value_length)) != NULL){
+      if (value_length > 0){
+        return value;
+      }
+    }
+    return NULL;
+  }
+  if (input == NULL){
+    return *next < num_inputs ? inputs[(*next)++] : NULL;
+  }
+  ssize_t length;
+  while((length = getline(line, line_size, input)) != -1){
+    if (length > 0 && (*line)[length - 1] == '\n'){
+      (*line)[--length] = '\0';
+    }
+    if (length > 0){
+      return *line;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * parallel_launch() - launches the command template for one input as a job of its own, every
+ *                     "{}" in an argument replaced by the input, or the input appended as the
+ *                     last argument if no argument has one
+ *
+ * Parameters:
+ *  - template: the command and its arguments, NULL terminated
+ *  - input: the input
+ *  - stdin_input: 1 if the inputs are read from standard input, which the job then doesn't get
+ *  - jobs: the parallel_jobs_t* to add the job to, which must have a free slot
+ *  - j_list: a job_list_t representing the list of current background jobs, which the job is
+ *            added to
+ *
+ * Returns:
+ *	- nothing (void) - a job that could not be started (which has been printed) counts as failed
+ */
+static void parallel_launch(char** template, char* input, int stdin_input, parallel_jobs_t* jobs,
+  job_list_t* j_list){
+  /* the arguments are built in one buffer, freed once the child is launched */
+  size_t input_length = strlen(input);
+  size_t size = 0;
+  int num_args = 0;
+  int substituted = 0;
+  for(; template[num_args] != NULL; num_args++){
+    size += strlen(template[num_args]) + 1;
+    for(char* found = template[num_args]; (found = strstr(found, "{}")) != NULL; found += 2){
+      size += input_length;
+      substituted = 1;
+    }
+  }
+  if (!substituted){
+    size += input_length + 1;
+  }
+  char** argv = (char**) malloc((size_t) (num_args + 2) * sizeof(char*));
+  char* buffer = (char*) malloc(size);
+  if (argv == NULL || buffer == NULL){
+    fprintf(stderr, "ERROR - Out of memory.\n");
+    free(argv);
+    free(buffer);
+    jobs->run++;
+    jobs->failed++;
+    return;
+  }
+  char* end = buffer;
+  for(int i = 0; i < num_args; i++){
+    argv[i] = end;
+    char* arg = template[i];
+    char* found;
+    while((found = strstr(arg, "{}")) != NULL){
+      memcpy(end, arg, (size_t) (found - arg));
+      end += found - arg;
+      memcpy(end, input, input_length);
+      end += input_length;
+      arg = found + 2;
+    }
+    end = stpcpy(end, arg) + 1;
+  }
+  if (!substituted){
+    argv[num_args++] = end;
+    memcpy(end, input, input_length + 1);
+  }
+  argv[num_args] = NULL;
+
+  launch_t stage = {NULL, argv, stdin_input ? "/dev/null" : NULL, NULL, 0, -1, -1, 0, 0, NULL,
+    -1};
+  cpu_set_t cpus;
+  place_stage(&stage, &cpus);
+  pid_t pid = start_stage(&stage);
+  jobs->run++;
+  if (pid == -1){
+    jobs->failed++;
+  } else {
+    parallel_add(jobs, j_list, pid, &stage, template[0]);
+  }
+  free(buffer);
+  free(argv);
+}
+
+/*
+ * parallel_wait() - waits for any child to exit, one of parallel's jobs freeing its slot and
+ *                   counting as failed if its exit status is not 0, and any other (a background
+ *                   job) being reported as usual, a SIGINT passes on to every running job
+ *
+ * Parameters:
+ *  - jobs: the parallel_jobs_t* of the running jobs
+ *  - j_list: a job_list_t representing the list of current background jobs, contatining job ID,
+ *            process ID, command, and state
+ *
+ * Returns:
+ *	- nothing (void)
+ */
+static void parallel_wait(parallel_jobs_t* jobs, job_list_t* j_list){
+  int status;
+  struct rusage usage;
+  pid_t pid = wait4(-1, &status, 0, &usage);
+  if (pid == -1){
+    if (errno == EINTR){
+      if (parallel_interrupted == 1){
+        /* passed on once, the jobs are then waited for as they exit */
+        parallel_interrupted = 2;
+        for(int i = 0; i < jobs->num_slots; i++){
+          if (jobs->pids[i] != 0){
+            signal_job(j_list, jobs->base_jid + 1 + i, SIGINT);
+          }
+        }
+      }
+      return;
+    }
+    /* no child left, which can only be if the jobs were reaped by someone else */
+    for(int i = 0; i < jobs->num_slots; i++){
+      if (jobs->pids[i] != 0){
+        finish_job(j_list, jobs->base_jid + 1 + i, 0);
+        jobs->pids[i] = 0;
+      }
+    }
+    jobs->running = 0;
+    return;
+  }
+  for(int i = 0; i < jobs->num_slots; i++){
+    if (jobs->pids[i] == pid){
+      if (TRACE_ON){
+        trace_status(pid, status);
+      }
+      reap_job_process(j_list, pid, status, &usage);
+      finish_job(j_list, jobs->base_jid + 1 + i, status);
+      jobs->pids[i] = 0;
+      jobs->running--;
+      if (exit_status(status) != 0){
+        jobs->failed++;
+      }
+      jobs->status = batch_status(jobs->status, status);
+      return;
+    }
+  }
+  report_change(j_list, pid, status, &usage);
+}
+
+/*
+ * handles parallel built-in, parallel [-j N] command [argument ...] [::: input ...], which runs
+ * the command once for each input (see parallel_launch()), read a line at a time from standard
+ * input if there is no ":::", with at most N (by default the number of CPUs) jobs running at a
+ * time, the next one started as soon as one exits, and then prints how many failed, its exit
+ * status being the number of jobs that failed, up to 100 (101 if more did, 130 if interrupted)
+ */
+static int builtin_parallel(int num_args, char** cmd_arg, job_list_t* j_list, int* jid,
+  timing_t* timing){
+  (void) timing;
+  if (refused_in_session("parallel")){
+    return 1;
+  }
+  long max_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  int first = 1;
+  if (first < num_args && !strncmp(cmd_arg[first], "-j", 2)){
+    char* number = cmd_arg[first][2] != '\0' ? &cmd_arg[first][2] : cmd_arg[++first];
+    char* end = NULL;
+    max_jobs = number == NULL ? 0 : strtol(number, &end, 10);
+    if (max_jobs < 1 || max_jobs > 65536 || *end != '\0'){
+      fprintf(stderr, "parallel: -j needs a number of jobs from 1 to 65536\n");
+      return 1;
+    }
+    first++;
+  }
+  if (max_jobs < 1){
+    max_jobs = 1;
+  }
+  int separator = first;
+  while(separator < num_args && strcmp(cmd_arg[separator], ":::")){
+    separator++;
+  }
+  if (separator == first){
+    fprintf(stderr, "usage: parallel [-j N] command [argument ...] [::: input ...]\n");
+    return 1;
+  }
+  /* the template is cut off at ":::", the inputs keep their NULL at the end */
+  int stdin_input = (separator == num_args);
+  cmd_arg[separator] = NULL;
+  /* standard input is the shell's own unless redirected, and then the shell may have read past
+     this line, into its reader, so a script's lines are read from there (a terminal's are read
+     as typed, and ^D ends only the inputs) */
+  line_reader_t* reader = stdin_input && builtin_stage->input == NULL && !interactive
+    ? builtin_reader : NULL;
+  FILE* input = NULL;
+  if (stdin_input && reader == NULL){
+    int fd = dup(STDIN_FILENO);
+    if (fd == -1 || (input = fdopen(fd, "r")) == NULL){
+      perror("parallel");
+      if (fd != -1){
+        close(fd);
+      }
+      return 1;
+    }
+  }
+  parallel_jobs_t jobs;
+  jobs.num_slots = (int) max_jobs;
+  jobs.pids = (pid_t*) calloc((size_t) jobs.num_slots, sizeof(pid_t));
+  jobs.running = 0;
+  jobs.base_jid = *jid;
+  jobs.run = 0;
+  jobs.failed = 0;
+  jobs.status = 0;
+  if (jobs.pids == NULL){
+    fprintf(stderr, "ERROR - Out of memory.\n");
+    if (input != NULL){
+      fclose(input);
+    }
+    return 1;
+  }
+  struct sigaction saved;
+  parallel_catch(&saved);
+  fflush(stdout);
+  int next = separator + 1;
+  char* line = NULL;
+  size_t line_size = 0;
+  char* value;
+  while(!parallel_interrupted
+      && (value = parallel_input(cmd_arg, num_args, &next, reader, input, &line, &line_size))
+         != NULL){
+    while(jobs.running == jobs.num_slots && !parallel_interrupted){
+      parallel_wait(&jobs, j_list);
+    }
+    if (!parallel_interrupted){
+      parallel_launch(&cmd_arg[first], value, stdin_input, &jobs, j_list);
+    }
+  }
+  while(jobs.running > 0){
+    parallel_wait(&jobs, j_list);
+  }
+  int interrupted = parallel_release(&saved);
+  free(line);
+  free(jobs.pids);
+  if (input != NULL){
+    fclose(input);
+  }
+  fprintf(stderr, "parallel: %ld jobs, %ld succeeded, %ld failed%s\n", jobs.run,
+    jobs.run - jobs.failed, jobs.failed, interrupted ? ", interrupted" : "");
+  if (interrupted){
+    return 130;
+  }
+  return jobs.failed > 100 ? 101 : (int) jobs.failed;
+}
+
+/* what batch leaves out of ARG_MAX besides the environment, as xargs does, since the kernel
+   counts a little more than the strings and their pointers */
+#define BATCH_HEADROOM 2048
+
+/* the room a command's arguments have, of ARG_MAX, each taking its length, its '\0' and its
+   pointer, after the environment, which is passed along with them */
+static long batch_room(){
+  long room = sysconf(_SC_ARG_MAX) - BATCH_HEADROOM - (long) sizeof(char*);
+  for(char** env = environ; *env != NULL; env++){
+    room -= (long) (strlen(*env) + 1 + sizeof(char*));
+  }
+  return room;
+}
+
+/*
+ * handles batch built-in, batch [-j N] command [argument ...] [::: argument ...], which runs the
+ * command as few times as it takes to pass it all the arguments after ":::" without going over
+ * ARG_MAX, each run getting as many as fit after the ones before ":::", or without ":::" the
+ * arguments after the command's leading options (up to "--"), which every run gets, runs going
+ * one at a time, or up to N at a time, as jobs like parallel's, and its exit status being as
+ * xargs gives it (see batch_status()), with no more runs started once one exits with 255, is
+ * killed or could not be started
+ */
+static int builtin_batch(int num_args, char** cmd_arg, job_list_t* j_list, int* jid,
+  timing_t* timing){
+  (void) timing;
+  if (refused_in_session("batch")){
+    return 1;
+  }
+  long max_jobs = 1;
+  int first = 1;
+  if (first < num_args && !strncmp(cmd_arg[first], "-j", 2)){
+    char* number = cmd_arg[first][2] != '\0' ? &cmd_arg[first][2] : cmd_arg[++first];
+    char* end = NULL;
+    max_jobs = number == NULL ? 0 : strtol(number, &end, 10);
+    if (max_jobs < 1 || max_jobs > 65536 || *end != '\0'){
+      fprintf(stderr, "batch: -j needs a number of jobs from 1 to 65536\n");
+      return 1;
+    }
+    first++;
+  }
+  if (first >= num_args){
+    fprintf(stderr, "usage: batch [-j N] command [argument ...] [::: argument ...]\n");
+    return 1;
+  }
+  /* the arguments every run gets end at ":::", or else after the command's options */
+  int fixed_end = first + 1;
+  while(fixed_end < num_args && strcmp(cmd_arg[fixed_end], ":::")){
+    fixed_end++;
+  }
+  int next = fixed_end + 1;
+  if (fixed_end == num_args){
+    fixed_end = first + 1;
+    while(fixed_end < num_args && cmd_arg[fixed_end][0] == '-' && cmd_arg[fixed_end][1] != '\0'){
+      if (!strcmp(cmd_arg[fixed_end++], "--")){
+        break;
+      }
+    }
+    next = fixed_end;
+  }
+  /* every argument must fit in a run with the fixed ones, and be no longer than the kernel
+     takes a single one (MAX_ARG_STRLEN) */
+  long room = batch_room();
+  for(int i = first; i < fixed_end; i++){
+    room -= (long) (strlen(cmd_arg[i]) + 1 + sizeof(char*));
+  }
+  if (room < 0){
+    fprintf(stderr, "batch: %s: the arguments every run gets are too long\n", cmd_arg[first]);
+    return 1;
+  }
+  long max_length = 32 * sysconf(_SC_PAGESIZE);
+  for(int i = next; i < num_args; i++){
+    long length = (long) strlen(cmd_arg[i]) + 1;
+    if (length > max_length || length + (long) sizeof(char*) > room){
+      fprintf(stderr, "batch: argument %d is too long to pass\n", i - next + 1);
+      return 1;
+    }
+  }
+  int num_fixed = fixed_end - first;
+  char** argv = (char**) malloc((size_t) (num_fixed + num_args - next + 1) * sizeof(char*));
+  parallel_jobs_t jobs;
+  jobs.num_slots = (int) max_jobs;
+  jobs.pids = (pid_t*) calloc((size_t) jobs.num_slots, sizeof(pid_t));
+  jobs.running = 0;
+  jobs.base_jid = *jid;
+  jobs.run = 0;
+  jobs.failed = 0;
+  jobs.status = 0;
+  if (argv == NULL || jobs.pids == NULL){
+    fprintf(stderr, "ERROR - Out of memory.\n");
+    free(argv);
+    free(jobs.pids);
+    return 1;
+  }
+  memcpy(argv, &cmd_arg[first], (size_t) num_fixed * sizeof(char*));
+  struct sigaction saved;
+  parallel_catch(&saved);
+  fflush(stdout);
+  /* a command with nothing to batch still runs once, as with xargs */
+  do {
+    while(jobs.running == jobs.num_slots && !parallel_interrupted){
+      parallel_wait(&jobs, j_list);
+    }
+    if (parallel_interrupted || jobs.status >= 124){
+      break;
+    }
+    int argc = num_fixed;
+    for(long used = 0; next < num_args; next++){
+      long size = (long) (strlen(cmd_arg[next]) + 1 + sizeof(char*));
+      if (used + size > room){
+        break;
+      }
+      used += size;
+      argv[argc++] = cmd_arg[next];
+    }
+    argv[argc] = NULL;
+    /* start_stage() shortens argv[0], so each run gets it back */
+    argv[0] = cmd_arg[first];
+    launch_t stage = {NULL, argv, NULL, NULL, 0, -1, -1, 0, 0, NULL, -1};
+    cpu_set_t cpus;
+    place_stage(&stage, &cpus);
+    pid_t pid = start_stage(&stage);
+    jobs.run++;
+    if (pid == -1){
+      jobs.failed++;
+      jobs.status = batch_status(jobs.status, errno == ENOENT ? -127 : -126);
+    } else {
+      parallel_add(&jobs, j_list, pid, &stage, cmd_arg[first]);
+    }
+  } while(next < num_args);
+  while(jobs.running > 0){
+    parallel_wait(&jobs, j_list);
+  }
+  int interrupted = parallel_release(&saved);
+  free(argv);
+  free(jobs.pids);
+  return interrupted ? 130 : jobs.status;
+}
+
+/*
+ * dispatch_queue() - starts queued commands (see submit) as background jobs for as long as the
+ *                    queue's limits allow, with /dev/null as their standard input since they
+ *                    start whenever a slot frees
+ *
+ * Parameters:
+ *  - j_list: a job_list_t representing the list of current background jobs, which each started
+ *            command is added to
+ *  - jid: an int* representing the current job id, which gets incremented by 1 on each new job
+ *
+ * Returns:
+ *	- an integer, the number of jobs started
+ */
+int dispatch_queue(job_list_t* j_list, int* jid){
+  int started = 0;
+  char** argv;
+  while(queue != NULL && (argv = next_queued(queue)) != NULL){
+    /* the job is known by its command as submitted, start_stage() shortens argv[0] */
+    char* command = argv[0];
+    launch_t stage = {NULL, argv, "/dev/null", NULL, 0, -1, -1, 0, 0, NULL, -1};
+    cpu_set_t cpus;
+    place_stage(&stage, &cpus);
+    fflush(stdout);
+    pid_t pid = start_stage(&stage);
+    if (pid == -1){
+      started_queued(queue, -1, W_EXITCODE(127, 0));
+      continue;
+    }
+    int job_id = *jid + 1;
+    *jid = job_id;
+    add_job(j_list, job_id, pid, _STATE_RUNNING, command);
+    hold_job_cpus(j_list, job_id, &stage);
+    started_queued(queue, job_id, 0);
+    started++;
+    if (printf("[%d] (%d)\n", job_id, pid) < 0){
+      fprintf(stderr, "ERROR - Message did not print successfully.\n");
+      cleanup_job_list(j_list);
+      exit(1);
+    }
+  }
+  return started;
+}
+
+/* handles submit built-in, submit [-p priority] command [argument ...], which queues the command
+   to run as a background job once the queue's limits allow (see queue.h), higher priorities
+   first */
+static int builtin_submit(int num_args, char** cmd_arg, job_list_t* j_list, int* jid,
+  timing_t* timing){
+  (void) timing;
+  long priority = 0;
+  int first = 1;
+  if (first < num_args && !strcmp(cmd_arg[first], "-p")){
+    char* end = NULL;
+    priority = first + 1 < num_args ? strtol(cmd_arg[first + 1], &end, 10) : 0;
+    if (end == NULL || end == cmd_arg[first + 1] || *end != '\0' || priority < -1000000
+        || priority > 1000000){
+      fprintf(stderr, "submit: -p needs a priority\n");
+      return 1;
+    }
+    first += 2;
+  }
+  if (first >= num_args){
+    fprintf(stderr, "usage: submit [-p priority] command [argument ...]\n");
+    return 1;
+  }
+  if (queue == NULL && (queue = init_job_queue()) == NULL){
+    fprintf(stderr, "ERROR - Out of memory.\n");
+    return 1;
+  }
+  int qid = enqueue_command(queue, (int) priority, &cmd_arg[first]);
+  if (qid == -1){
+    fprintf(stderr, "ERROR - Out of memory.\n");
+    return 1;
+  }
+  if (printf("[q%d]\n", qid) < 0){
+    fprintf(stderr, "ERROR - Message did not print successfully.\n");
+    cleanup_job_list(j_list);
+    exit(1);
+  }
+  dispatch_queue(j_list, jid);
+  return 0;
+}
+
+/* handles queue built-in, queue [-j slots] [-c cpu] [-m memory], which sets the limits of the
+   submit queue (see queue_limits_t), or with no options shows them and the current pressure */
+static int builtin_queue(int num_args, char** cmd_arg, job_list_t* j_list, int* jid,
+  timing_t* timing){
+  (void) timing;
+  if (queue == NULL && (queue = init_job_queue()) == NULL){
+    fprintf(stderr, "ERROR - Out of memory.\n");
+    return 1;
+  }
+  if (num_args == 1){
+    print_queue_limits(queue);
+    return 0;
+  }
+  queue_limits_t limits;
+  get_queue_limits(queue, &limits);
+  for(int i = 1; i < num_args; i += 2){
+    char* end = NULL;
+    double value = i + 1 < num_args ? strtod(cmd_arg[i + 1], &end) : -1;
+    if (end == NULL || end == cmd_arg[i + 1] || *end != '\0' || value < 0){
+      fprintf(stderr, "usage: queue [-j slots] [-c cpu] [-m memory]\n");
+      return 1;
+    }
+    if (!strcmp(cmd_arg[i], "-j") && value <= 65536){
+      limits.slots = (int) value;
+    } else if (!strcmp(cmd_arg[i], "-c")){
+      limits.cpu = value;
+    } else if (!strcmp(cmd_arg[i], "-m")){
+      limits.memory = value;
+    } else {
+      fprintf(stderr, "usage: queue [-j slots] [-c cpu] [-m memory]\n");
+      return 1;
+    }
+  }
+  set_queue_limits(queue, &limits);
+  dispatch_queue(j_list, jid);
+  return 0;
+}
+
+/* handles placement built-in, placement [none|cores|nodes], which sets where background jobs
+   are run (see placement.h), or with no argument shows it and the jobs on each CPU */
+static int builtin_placement(int num_args, char** cmd_arg, job_list_t* j_list, int* jid,
+  timing_t* timing){
+  (void) j_list;
+  (void) jid;
+  (void) timing;
+  if (num_args == 1){
+    print_placement();
+    return 0;
+  }
+  if (!strcmp(cmd_arg[1], "none")){
+    set_placement_policy(PLACE_NONE);
+  } else if (!strcmp(cmd_arg[1], "cores")){
+    set_placement_policy(PLACE_CORES);
+  } else if (!strcmp(cmd_arg[1], "nodes")){
+    set_placement_policy(PLACE_NODES);
+  } else {
+    fprintf(stderr, "usage: placement [none|cores|nodes]\n");
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * builtin_cache() - handles cache built-in, "cache command [arg ...]" runs a command as a job
+ *                   once for the same inputs (see cache.h) and after that replays its standard
+ *                   output and exit status from the store, "cache stats" shows the store,
+ *                   "cache limit [size]" shows or sets its size limit and "cache clear" empties it
+ *
+ * Parameters:
+ *  - num_args, cmd_arg, j_list, jid: as for any shell builtin
+ *  - timing: a timing_t* for the command's job if it is timed, NULL else
+ *
+ * Returns:
+ *	- the exit status of the command, run or replayed, or of the subcommand
+ */
+static int builtin_cache(int num_args, char** cmd_arg, job_list_t* j_list, int* jid,
+  timing_t* timing){
+  if (num_args == 1){
+    fprintf(stderr, "usage: cache command [arg ...] | stats | limit [size] | clear\n");
+    return 2;
+  }
+  if (num_args == 2 && !strcmp(cmd_arg[1], "stats")){
+    print_cache_stats();
+    return 0;
+  }
+  if (num_args == 2 && !strcmp(cmd_arg[1], "clear")){
+    if (clear_cache() == -1){
+      fprintf(stderr, "cache: no store\n");
+      return 1;
+    }
+    return 0;
+  }
+  if (num_args <= 3 && !strcmp(cmd_arg[1], "limit")){
+    off_t limit;
+    if (num_args == 2){
+      printf("%lld\n", (long long) get_cache_limit());
+      return 0;
+    }
+    if (parse_cache_size(cmd_arg[2], &limit) == -1){
+      fprintf(stderr, "cache: %s: not a size\n", cmd_arg[2]);
+      return 1;
+    }
+    set_cache_limit(limit);
+    return 0;
+  }
+  /* the program is looked up as start_stage() would, since which one it is is part of the key */
+  char* name = cmd_arg[1];
+  const char* path = strchr(name, '/') != NULL ? name : resolve_command(name);
+  if (path == NULL){
+    fprintf(stderr, "%s: command not found\n", name);
+    return 127;
+  }
+  char* input = builtin_stage != NULL ? builtin_stage->input : NULL;
+  cache_key_t key;
+  int keyed = make_cache_key(&key, &cmd_arg[1], path, input != NULL ? STDIN_FILENO : -1) == 0;
+  /* what the shell printed before goes first */
+  fflush(stdout);
+  int status;
+  if (keyed && (status = replay_cached(&key, STDOUT_FILENO)) != -1){
+    return status;
+  }
+  /* a miss runs the command with its output going to the store, then copied to standard output,
+     with no input but the file given with "<", since nothing else is in the key, and it is
+     waited for, except in a server session, where that would hold up every other session, so
+     the command runs there as an ordinary foreground job, parking only its session, and its
+     output is not stored */
+  char* temp = keyed && session == NULL ? cache_temp_path() : NULL;
+  launch_t stage = {NULL, &cmd_arg[1], input != NULL ? input : "/dev/null", temp, 0, -1, -1, 0,
+    0, NULL, -1};
+  timing_t waited;
+  int job_id = *jid + 1;
+  status = run_child_process(&stage, 1, 0, j_list, jid,
+    session != NULL ? NULL : timing != NULL ? timing : &waited);
+  if (temp == NULL){
+    return status;
+  }
+  if (get_job_pid(j_list, job_id) != -1){
+    fprintf(stderr, "cache: [%d] stopped, its output goes to %s\n", job_id, temp);
+    return status;
+  }
+  if (store_cached(&key, temp, status, STDOUT_FILENO) == -1){
+    perror("cache");
+  }
+  return status;
+}
+
+/* a builtin, either one of the shell's own (shell), or an in-process version of a utility
+   (utility, see builtins.h), which still runs as a program in a pipeline or in the background,
+   and also if given these arguments it would read the shell's own input (reads_input, checked
+   if no "<" is given) */
+typedef struct builtin {
+  const char* name;
+  int (*shell)(int num_args, char** cmd_arg, job_list_t* j_list, int* jid, timing_t* timing);
+  int (*utility)(int argc, char** argv);
+  int (*reads_input)(int argc, char** argv);
+} builtin_t;
+
+/* sorted by name, for bsearch() */
+static const builtin_t builtin_table[] = {
+  {"[", NULL, builtin_test, NULL},
+  {"batch", builtin_batch, NULL, NULL},
+  {"bg", builtin_bg, NULL, NULL},
+  {"cache", builtin_cache, NULL, NULL},
+  {"cat", NULL, builtin_cat, builtin_cat_reads_input},
+  {"cd", builtin_cd, NULL, NULL},
+  {"cp", NULL, builtin_cp, NULL},
+  {"echo", NULL, builtin_echo, NULL},
+  {"exit", builtin_exit, NULL, NULL},
+  {"false", NULL, builtin_false, NULL},
+  {"fg", builtin_fg, NULL, NULL},
+  {"hash", builtin_hash, NULL, NULL},
+  {"jobs", builtin_jobs, NULL, NULL},
+  {"ln", builtin_ln, NULL, NULL},
+  {"mv", NULL, builtin_mv, NULL},
+  {"parallel", builtin_parallel, NULL, NULL},
+  {"pipesize", builtin_pipesize, NULL, NULL},
+  {"placement", builtin_placement, NULL, NULL},
+  {"printf", NULL, builtin_printf, NULL},
+  {"queue", builtin_queue, NULL, NULL},
+  {"rm", builtin_rm, NULL, NULL},
+  {"submit", builtin_submit, NULL, NULL},
+  {"test", NULL, builtin_test, NULL},
+  {"true", NULL, builtin_true, NULL},
+};
+
+static int compare_builtin(const void* name, const void* builtin){
+  return strcmp((const char*) name, ((const builtin_t*) builtin)->name);
+}
+
+/* finds a builtin by name, returns NULL if there is none */
+static const builtin_t* find_builtin(const char* name){
+  return (const builtin_t*) bsearch(name, builtin_table,
+    sizeof(builtin_table) / sizeof(builtin_table[0]), sizeof(builtin_t), compare_builtin);
+}
+
+/*
+ * redirect_builtin() - applies a command's redirections to the shell's own standard input and
+ *                      output for a builtin, keeping copies of the ones they replace
+ *
+ * Parameters:
+ *  - stage: the launch_t* of the command, with its redirection files
+ *  - saved: an int array of two, set to the copies of standard input and output (-1 for the ones
+ *           not redirected), for restore_builtin()
+ *
+ * Returns:
+ *	- 0 on success, -1 if a file could not be opened (which has been printed, and nothing is
+ *    redirected then)
+ */
+static int redirect_builtin(launch_t* stage, int saved[2]){
+  saved[0] = saved[1] = -1;
+  if (stage->input == NULL && stage->output == NULL){
+    return 0;
+  }
+  /* both files are opened first, so a failure leaves nothing to undo */
+  int in_fd = -1, out_fd = -1;
+  if (stage->input != NULL && (in_fd = open(stage->input, O_RDONLY | O_CLOEXEC)) == -1){
+    perror("open");
+    return -1;
+  }
+  if (stage->output != NULL){
+    int options = O_WRONLY | O_CREAT | O_CLOEXEC | (stage->append ? O_APPEND : O_TRUNC);
+    if ((out_fd = open(stage->output, options, 0666)) == -1){
+      perror("open");
+      if (in_fd != -1){
+        close(in_fd);
+      }
+      return -1;
+    }
+  }
+  /* anything the shell has buffered goes out before standard output moves */
+  fflush(stdout);
+  if (in_fd != -1){
+    saved[0] = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 10);
+    dup2(in_fd, STDIN_FILENO);
+    close(in_fd);
+  }
+  if (out_fd != -1){
+    saved[1] = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 10);
+    dup2(out_fd, STDOUT_FILENO);
+    close(out_fd);
+  }
+  return 0;
+}
+
+/* puts back the standard input and output saved by redirect_builtin() */
+static void restore_builtin(int saved[2]){
+  fflush(stdout);
+  for(int fd = 0; fd < 2; fd++){
+    if (saved[fd] != -1){
+      dup2(saved[fd], fd);
+      close(saved[fd]);
+    }
+  }
+}
+
+/*
+ * run_command() - runs a builtin (see builtin_table) in the shell, with the command's
+ *                 redirections applied to the shell's own standard input and output meanwhile
+ *
+ * Parameters:
+ *  - num_args: the number of arguments in the user input (not including redirections)
+ *	- cmd_arg: an array of strings (char**) to hold all the tokens representing the arguments to
+ *             the command (again not including redirection)
+ *  - stage: the launch_t* of the command, for its redirections
+ *  - background: 1 if the command was given a trailing "&", 0 else
+ *  - j_list: a job_list_t representing the list of current background jobs, contatining job ID,
+ *            process ID, command, and state
+ *  - jid: an int* representing the current job id, the job ids after it are free for the
+ *         builtin's own jobs (see builtin_parallel())
+ *  - timing: a timing_t* for fg to fill in if the command is timed, NULL else
+ *
+ * Returns:
+ *	- an integer, -1 if the command is to be run as a program (it is no builtin, or one that
+ *    stands in for a program which has to run this time), else the exit status of the builtin
+ */
+int run_command(int num_args, char** cmd_arg, launch_t* stage, int background,
+  job_list_t* j_list, int* jid, timing_t* timing){
+  const builtin_t* builtin = find_builtin(cmd_arg[0]);
+  if (builtin == NULL){
+    return -1;
+  }
+  int reads_input = builtin->reads_input != NULL && stage->input == NULL
+    && builtin->reads_input(num_args, cmd_arg);
+  /* reading the shell's input, it runs as a program, which the input is handed back to, unless
+     it is a pipe the shell has read ahead of, as the program wouldn't get what was read, and it
+     then runs here, reading that first (a terminal is left to the program, for ^C and ^Z) */
+  size_t ahead_len = 0;
+  char* ahead = NULL;
+  if (builtin->utility != NULL && reads_input && !background && !interactive
+      && builtin_reader != NULL){
+    ahead = read_ahead(builtin_reader, &ahead_len);
+  }
+  if (builtin->utility != NULL && (background || (reads_input && ahead == NULL))){
+    return -1;
+  }
+  int saved[2];
+  if (redirect_builtin(stage, saved) == -1){
+    return 1;
+  }
+  double start = TRACE_ON ? trace_now() : 0;
+  int status;
+  if (builtin->shell != NULL){
+    builtin_stage = stage;
+    status = builtin->shell(num_args, cmd_arg, j_list, jid, timing);
+    builtin_stage = NULL;
+  } else {
+    set_input_ahead(ahead, ahead_len);
+    status = builtin->utility(num_args, cmd_arg);
+    if (ahead != NULL && take_input_ahead() == 0){
+      skip_read_ahead(builtin_reader);
+    }
+  }
+  restore_builtin(saved);
+  if (TRACE_ON){
+    trace_span("builtin", start, 0, cmd_arg[0]);
+  }
+  return status == BUILTIN_UNSUPPORTED ? -1 : status;
+}
+
+/*
+ * build_stage() - parses the redirections of one stage of a pipeline and gathers its arguments,
+ *                 filling in the stage's launch with everything but its pipe ends and process
+ *                 group, which run_child_process() sets once the stages are started
+ *
+ * Parameters:
+ *  - num_tokens: an integer representing the number of tokens in the stage
+ *	- tokens: an array of token_t holding the stage's tokens (including redirection), the text
+ *            of the redirection files is set to NULL
+ *	- cmd_arg: an array of strings (char**) with room for num_tokens + 1 strings, to hold the
+ *             stage's arguments followed by NULL
+ *  - stage: a launch_t* to fill in for the stage
+ *
+ * Returns:
+ *	- an integer, the number of arguments of the stage, or -1 if there was an error in parsing
+ *    (which has been printed)
+ */
+int build_stage(int num_tokens, token_t* tokens, char** cmd_arg, launch_t* stage){
+  /* instantiates redirection int flags and array for filenames */
+  int redirect_input = 0;
+  int redirect_output = 0;
+  int redirect_output_append = 0;
+  char* redirect_arr[3];
+  if (check_redirects(num_tokens, &redirect_input, &redirect_output, &redirect_output_append,
+      redirect_arr, tokens)){
+    return -1;
+  }
+  /* create command arguments array, skipping the redirections */
+  int num_args = 0;
+  for(int i = 0; i < num_tokens; i++){
+    if (tokens[i].type == TOKEN_WORD && tokens[i].text != NULL){
+      cmd_arg[num_args] = tokens[i].text;
+      num_args++;
+    }
+  }
+  cmd_arg[num_args] = NULL;
+  if (!num_args){
+    fprintf(stderr, "ERROR - No command.\n");
+    return -1;
+  }
+  stage->path = NULL;
+  stage->argv = cmd_arg;
+  stage->input = redirect_input ? redirect_arr[0] : NULL;
+  stage->output = NULL;
+  if (redirect_output){
+    stage->output = redirect_arr[1];
+  }
+  if (redirect_output_append){
+    stage->output = redirect_arr[2];
+  }
+  stage->append = redirect_output_append;
+  stage->in_fd = -1;
+  stage->out_fd = -1;
+  stage->pgid = 0;
+  stage->foreground = 0;
+  stage->cpus = NULL;
+  stage->node = -1;
+  return num_args;
+}
+
+/*
+ * start_stage() - looks up the command of a stage, through the PATH cache if it has no '/', and
+ *                 launches it (see launch.c), printing why if it could not be launched
+ *
+ * Parameters:
+ *  - stage: a launch_t* built by build_stage(), with its pipe ends and process group set, its
+ *           argv[0] gets changed to just the executable
+ *
+ * Returns:
+ *	- a pid_t, the pid of the child, or -1 if it could not be launched
+ */
+pid_t start_stage(launch_t* stage){
+  /* keeps pointer to full path, changes path pointer in command array to just the executable */
+  char* full_path = stage->argv[0];
+  char* last_in_path = strrchr(full_path, '/');
+  if (last_in_path != NULL){
+    stage->argv[0] = last_in_path + 1;
+  }
+  /* a command without a '/' is looked up in PATH, through the cache */
+  const char* exec_path = full_path;
+  int hashed = (last_in_path == NULL);
+  if (hashed && (exec_path = resolve_command(full_path)) == NULL){
+    fprintf(stderr, "%s: command not found\n", full_path);
+    errno = ENOENT;
+    return -1;
+  }
+  stage->path = exec_path;
+  pid_t pid_child = launch_child(stage);
+  /* a cached path that can no longer be executed is dropped and looked up again, once */
+  if (pid_child == -1 && hashed && (errno == ENOENT || errno == EACCES || errno == ENOEXEC)){
+    forget_command(full_path);
+    if ((stage->path = resolve_command(full_path)) != NULL){
+      pid_child = launch_child(stage);
+    } else {
+      errno = ENOENT;
+    }
+  }
+  /* errno is kept for the caller, which may tell why */
+  if (pid_child == -1){
+    int error = errno;
+    fprintf(stderr, "%s: %s%s\n", full_path, strerror(error),
+      error == E2BIG ? " (batch splits them up)" : "");
+    errno = error;
+  }
+  return pid_child;
+}
+
+/*
+ * run_child_process() - launches a child proceess for each stage of a pipeline in order to run
+ *                       its command (see launch.c), connecting each one's standard output to the
+ *                       next one's standard input, all in one process group, and either waits for
+ *                       the job or leaves it in the jobs list as a background job
+ *
+ * Parameters:
+ *  - stages: an array of launch_t built by build_stage(), one for each stage of the pipeline
+ *  - num_stages: the number of stages, 1 for a simple command
+ *  - background_process: an int flag for if its is a background process, 1 if true and 0 else
+ *  - j_list: a job_list_t representing the list of current background jobs, contatining job ID,
+ *            process ID, command, and state
+ *  - jid: an int* representing the current job id, which gets incremented by 1 on each new job
+ *  - timing: a timing_t* to fill in if the job is timed, NULL else
+ *
+ * Returns:
+ *	- the exit status of the job (see exit_status()), 0 for a background job, and 127 if none of
+ *    its stages could be started
+ */
+int run_child_process(launch_t* stages, int num_stages, int background_process,
+  job_list_t* j_list, int* jid, timing_t* timing){
+  /* the job is known by the command of its first stage, as typed */
+  char* command = stages[0].argv[0];
+  int job_id = *jid + 1;
+  pid_t pid_parent = getpid();
+  pid_t pgid = 0;
+  int in_fd = -1;
+  /* the terminal is only handed over if the shell is interactive, not when reading a script or
+     a pipe, or with -c */
+  int terminal = !background_process && interactive;
+  /* every stage runs on the CPUs given with cpus=, or else for a background job on those the
+     placement policy picks */
+  cpu_set_t cpus;
+  if (stages[0].cpus == NULL && background_process){
+    place_stage(&stages[0], &cpus);
+  }
+  for(int i = 0; i < num_stages; i++){
+    stages[i].cpus = stages[0].cpus;
+    stages[i].node = stages[0].node;
+    int fds[2] = {-1, -1};
+    if (i < num_stages - 1 && open_pipe(fds) == -1){
+      /* the remaining stages could not be connected, so they are not started */
+      perror("pipe");
+      break;
+    }
+    stages[i].in_fd = in_fd;
+    stages[i].out_fd = fds[1];
+    stages[i].pgid = pgid;
+    stages[i].foreground = terminal;
+    pid_t pid_child = start_stage(&stages[i]);
+    /* the children have their own copies of the pipe ends, the shell keeps only the read end
+       for the next stage */
+    if (in_fd != -1){
+      close(in_fd);
+    }
+    if (fds[1] != -1){
+      close(fds[1]);
+    }
+    in_fd = fds[0];
+    /* a stage that failed to launch is skipped, the next one reads end of file instead */
+    if (pid_child == -1){
+      continue;
+    }
+    /* the first stage that launched leads the process group, and the job is added with it */
+    if (!pgid){
+      pgid = pid_child;
+      add_job(j_list, job_id, pgid, _STATE_RUNNING, command);
+      hold_job_cpus(j_list, job_id, &stages[i]);
+    } else {
+      add_job_process(j_list, job_id, pid_child);
+    }
+  }
+  if (in_fd != -1){
+    close(in_fd);
+  }
+  if (!pgid){
+    /* a child may have taken the terminal before failing */
+    if (!background_process){
+      give_terminal(pid_parent, j_list);
+    }
+    return 127;
+  }
+  /* keeps background job in the jobs list and prints */
+  if (background_process) {
+    *jid = job_id;
+    if (printf("[%d] (%d)\n", job_id, pgid) < 0){
+      fprintf(stderr, "ERROR - Message did not print successfully.\n");
+      cleanup_job_list(j_list);
+      exit(1);
+    }
+    give_terminal(pid_parent, j_list);
+    return 0;
+  }
+  /* a session's foreground job is waited for by the server's loop, which serves the other
+     sessions meanwhile, and the session goes on once it is done (see report_change()) */
+  if (session != NULL && timing == NULL){
+    *jid = job_id;
+    session->waiting_jid = job_id;
+    return 0;
+  }
+  /* if not waits for changes in status */
+  int status = wait_job(j_list, job_id, timing);
+  /* if job stopped by a signal, it stays in the jobs list */
+  if (WIFSTOPPED(status)){
+    int signal_num = WSTOPSIG(status);
+    *jid = job_id;
+    if (printf("[%d] (%d) suspended by signal %d\n", job_id, pgid, signal_num) < 0){
+      fprintf(stderr, "ERROR - Message did not print successfully.\n");
+      cleanup_job_list(j_list);
+      exit(1);
+    }
+  }
+  /* if job terminated with a signal */
+  if (WIFSIGNALED(status)){
+    int signal_num = WTERMSIG(status);
+    *jid = job_id;
+    if (printf("[%d] (%d) terminated by signal %d\n", job_id, pgid, signal_num) < 0){
+      fprintf(stderr, "ERROR - Message did not print successfully.\n");
+      cleanup_job_list(j_list);
+      exit(1);
+    }
+  }
+  /* transfer control back to shell */
+  give_terminal(pid_parent, j_list);
+  return exit_status(status);
+}
+
+/*
+ * siginfo_status() - packs the change reported by waitid() into a status as from waitpid(), so
+ *                    it can be kept and examined with the W* macros
+ *
+ * Parameters:
+ *  - info: a siginfo_t* filled in by waitid()
+ *
+ * Returns:
+ *	- an integer, the status
+ */
+int siginfo_status(siginfo_t* info){
+  switch (info->si_code){
+    case CLD_EXITED:
+      return W_EXITCODE(info->si_status, 0);
+    case CLD_KILLED:
+      return W_EXITCODE(0, info->si_status);
+    case CLD_DUMPED:
+      return W_EXITCODE(0, info->si_status) | WCOREFLAG;
+    case CLD_STOPPED:
+    case CLD_TRAPPED:
+      return W_STOPCODE(info->si_status);
+    default:
+      return 0xffff;
+  }
+}
+
+/*
+ * report_change() - updates the job list for a job whose process changed state and prints an
+ *                   informative message, a job only exits once its last process has exited
+ *
+ * Parameters:
+ *  - j_list: a job_list_t representing the list of current background jobs, contatining job ID,
+ *            process ID, command, and state
+ *  - pid: the pid of the process that changed state
+ *  - status: the change, as a status from waitpid() (see siginfo_status())
+ *  - usage: the resource usage of the process if it exited, NULL if unknown
+ *
+ * Returns:
+ *	- an integer, 1 if a message was printed, 0 if the change was not one worth reporting
+ */
+int report_change(job_list_t* j_list, pid_t pid, int status, struct rusage* usage){
+  if (TRACE_ON){
+    trace_status(pid, status);
+  }
+  int job_id = get_job_jid(j_list, pid);
+  /* a child that is not a job has nothing to report, it has been reaped and that is all */
+  if (job_id == -1){
+    return 0;
+  }
+  pid_t pgid = get_job_pid(j_list, job_id);
+  /* a session's foreground job is reported as run_child_process() would, and its status is the
+     session's last status */
+  int foreground = session != NULL && job_id == session->waiting_jid;
+  if (WIFEXITED(status) || WIFSIGNALED(status)){
+    /* the job is only done once every stage is, and then its status is the last stage's */
+    if (reap_job_process(j_list, pid, status, usage) != 0){
+      return 0;
+    }
+    status = get_job_status(j_list, job_id);
+    finish_job(j_list, job_id, status);
+  }
+  if (foreground && !WIFCONTINUED(status)){
+    session->waiting_jid = -1;
+    last_status = exit_status(status);
+  }
+  /* if process exits normally */
+  if (WIFEXITED(status) && !foreground){
+    int exit_st = WEXITSTATUS(status);
+    if (printf("[%d] (%d) terminated with exit status %d\n", job_id, pgid, exit_st) < 0){
+      fprintf(stderr, "ERROR - Message did not print successfully.\n");
+      cleanup_job_list(j_list);
+      exit(1);
+    }
+  }
+  /* if process terminated with a signal */
+  if (WIFSIGNALED(status)){
+    int sig_exit_status = WTERMSIG(status);
+    if (printf("[%d] (%d) terminated by signal %d\n", job_id, pgid, sig_exit_status) < 0){
+      fprintf(stderr, "ERROR - Message did not print successfully.\n");
+      cleanup_job_list(j_list);
+      exit(1);
+    }
+  }
+  /* if process stopped by a signal, reported once for the whole job */
+  if (WIFSTOPPED(status)){
+    if (get_job_state(j_list, job_id) == _STATE_STOPPED){
+      return 0;
+    }
+    update_job_jid(j_list, job_id, _STATE_STOPPED);
+    int signal_num = WSTOPSIG(status);
+    if (printf("[%d] (%d) suspended by signal %d\n", job_id, pgid, signal_num) < 0){
+      fprintf(stderr, "ERROR - Message did not print successfully.\n");
+      cleanup_job_list(j_list);
+      exit(1);
+    }
+  }
+  /* if process continued by a signal, reported once for the whole job (bg has already marked
+     it running, so it is reported for one of its processes instead) */
+  if (WIFCONTINUED(status)){
+    if (pid != get_job_running_pid(j_list, job_id)){
+      return 0;
+    }
+    update_job_jid(j_list, job_id, _STATE_RUNNING);
+    if (printf("[%d] (%d) resumed\n", job_id, pgid) < 0){
+      fprintf(stderr, "ERROR - Message did not print successfully.\n");
+      cleanup_job_list(j_list);
+      exit(1);
+    }
+  }
+  return 1;
+}
+
+/*
+ * reap() - reaps only the children that have stopped or continued, by calling waitid() on any
+ *          child until it reports that none are left, exits are left to reap_exited() unless
+ *          some process could not get a pidfd
+ *
+ * Parameters:
+ *  - j_list: a job_list_t representing the list of current background jobs, contatining job ID,
+ *            process ID, command, and state
+ *
+ * Returns:
+ *	- an integer, the number of job changes that were reported
+ */
+int reap(job_list_t* j_list){
+  int reported = 0;
+  int options = WSTOPPED | WCONTINUED | WNOHANG;
+  if (has_untracked_jobs(j_list)){
+    options |= WEXITED;
+  }
+  while(1){
+    /* note: if si_pid is still 0 then no child has changed state, and we are done */
+    siginfo_t info;
+    struct rusage usage;
+    info.si_pid = 0;
+    if (waitid_usage(P_ALL, 0, &info, options, &usage) == -1){
+      if (errno == ECHILD){
+        return reported;
+      }
+      fprintf(stderr, "ERROR - Child process did not execute properly.\n");
+      cleanup_job_list(j_list);
+      exit(1);
+    }
+    if (info.si_pid == 0){
+      return reported;
+    }
+    reported += report_change(j_list, info.si_pid, siginfo_status(&info), &usage);
+  }
+}
+
+/*
+ * reap_exited() - reaps the processes whose pidfds reported an exit on the job list's epoll fd,
+ *                 with waitid() on each pidfd, so only the processes that exited are touched
+ *
+ * Parameters:
+ *  - j_list: a job_list_t representing the list of current background jobs, contatining job ID,
+ *            process ID, command, and state
+ *
+ * Returns:
+ *	- an integer, the number of job exits that were reported
+ */
+int reap_exited(job_list_t* j_list){
+  int reported = 0;
+  pid_t pid;
+  while((pid = get_exited_pid(j_list)) != -1){
+    int pidfd = get_process_pidfd(j_list, pid);
+    siginfo_t info;
+    struct rusage usage;
+    info.si_pid = 0;
+    if (pidfd == -1
+        || waitid_usage(P_PIDFD, (id_t) pidfd, &info, WEXITED | WNOHANG, &usage) == -1
+        || info.si_pid == 0){
+      /* the process is already gone, so it can only be dropped, along with its job if it was
+         the last one */
+      int job_id = get_job_jid(j_list, pid);
+      if (reap_job_process(j_list, pid, 0, NULL) == 0){
+        finish_job(j_list, job_id, 0);
+        /* a session waiting for it as its foreground job goes on, as after report_change() */
+        if (session != NULL && job_id == session->waiting_jid){
+          session->waiting_jid = -1;
+          last_status = 0;
+        }
+      }
+      continue;
+    }
+    reported += report_change(j_list, pid, siginfo_status(&info), &usage);
+  }
+  return reported;
+}
+
+/*
+ * print_time() - prints what the time prefix measured to standard error: the wall clock time,
+ *                and the user and system time, peak resident set size, context switches and page
+ *                faults of the job's processes (or of the shell itself, for a builtin)
+ *
+ * Parameters:
+ *  - start_time: a struct timespec* holding CLOCK_MONOTONIC from before the command
+ *  - start_usage: a struct rusage* holding the shell's own usage from before the command
+ *  - timing: a timing_t* filled in by wait_job() if a job was waited for
+ *
+ * Returns:
+ *	- nothing (void) - prints nothing if the job was stopped, "time fg" times it once resumed
+ */
+void print_time(struct timespec* start_time, struct rusage* start_usage, timing_t* timing){
+  if (timing->waited && timing->stopped){
+    return;
+  }
+  struct timespec end_time;
+  clock_gettime(CLOCK_MONOTONIC, &end_time);
+  /* the command's own output goes first */
+  fflush(stdout);
+  struct rusage usage;
+  if (timing->waited){
+    usage = timing->usage;
+  } else {
+    /* a builtin ran in the shell, so it is charged what the shell used meanwhile */
+    getrusage(RUSAGE_SELF, &usage);
+    timersub(&usage.ru_utime, &start_usage->ru_utime, &usage.ru_utime);
+    timersub(&usage.ru_stime, &start_usage->ru_stime, &usage.ru_stime);
+    usage.ru_nvcsw -= start_usage->ru_nvcsw;
+    usage.ru_nivcsw -= start_usage->ru_nivcsw;
+    usage.ru_minflt -= start_usage->ru_minflt;
+    usage.ru_majflt -= start_usage->ru_majflt;
+  }
+  double real = (double) (end_time.tv_sec - start_time->tv_sec)
+    + (double) (end_time.tv_nsec - start_time->tv_nsec) / 1e9;
+  fprintf(stderr, "real\t%.3fs\n", real);
+  fprintf(stderr, "user\t%ld.%03lds\n", (long) usage.ru_utime.tv_sec,
+    (long) usage.ru_utime.tv_usec / 1000);
+  fprintf(stderr, "sys\t%ld.%03lds\n", (long) usage.ru_stime.tv_sec,
+    (long) usage.ru_stime.tv_usec / 1000);
+  fprintf(stderr, "maxrss\t%ld KiB\n", usage.ru_maxrss);
+  fprintf(stderr, "ctxsw\t%ld voluntary, %ld involuntary\n", usage.ru_nvcsw, usage.ru_nivcsw);
+  fprintf(stderr, "faults\t%ld minor, %ld major\n", usage.ru_minflt, usage.ru_majflt);
+}
+
+/*
+ * wait_for_input() - waits until there is user input to read, reaping jobs whenever a SIGCHLD
+ *                    arrives on the signalfd or a job's pidfd reports an exit in the meantime, so
+ *                    their changes are reported as soon as they happen, if a line is already
+ *                    buffered it only reaps what is pending (and only if there are jobs), and
+ *                    starting queued commands (see submit) as jobs exit, or as the pressure
+ *                    drops for a queue held back by it, which is checked again every so often
+ *
+ * Parameters:
+ *  - sig_fd: the signalfd that SIGCHLD is read from
+ *  - j_list: a job_list_t representing the list of current background jobs, contatining job ID,
+ *            process ID, command, and state
+ *  - reader: the line_reader_t* that standard input is read through
+ *  - jid: an int* representing the current job id, which gets incremented by 1 on each new job
+ *
+ * Returns:
+ *	- nothing (void) - returns once standard input is readable (or at end of file)
+ */
+void wait_for_input(int sig_fd, job_list_t* j_list, line_reader_t* reader, int* jid){
+  int buffered = has_buffered_line(reader);
+  if (buffered && !get_num_jobs(j_list)){
+    return;
+  }
+  struct pollfd fds[3];
+  /* a negative fd is skipped by poll() */
+  fds[0].fd = buffered ? -1 : STDIN_FILENO;
+  fds[0].events = POLLIN;
+  fds[1].fd = sig_fd;
+  fds[1].events = POLLIN;
+  fds[2].fd = get_job_epoll_fd(j_list);
+  fds[2].events = POLLIN;
+  while(1){
+    int timeout = buffered ? 0 : (queue != NULL ? queue_retry_ms(queue) : -1);
+    if (poll(fds, 3, timeout) == -1){
+      if (errno == EINTR){
+        continue;
+      }
+      perror("poll");
+      cleanup_job_list(j_list);
+      exit(1);
+    }
+    int reported = 0;
+    if (fds[1].revents & POLLIN){
+      /* drains the signalfd, pending SIGCHLDs are merged so one reap covers all of them */
+      struct signalfd_siginfo sig_info;
+      while (read(sig_fd, &sig_info, sizeof(sig_info)) > 0){
+      }
+      reported += reap(j_list);
+    }
+    if (fds[2].revents & POLLIN){
+      reported += reap_exited(j_list);
+    }
+    if (queue != NULL){
+      reported += dispatch_queue(j_list, jid);
+    }
+    if (reported > 0){
+      /* prompts again, since the messages were printed over the old prompt */
+      #ifdef PROMPT
+      if (interactive && printf("33sh> ") < 0){
+        fprintf(stderr, "ERROR - Prompt did not print successfully.\n");
+        cleanup_job_list(j_list);
+        exit(1);
+      }
+      #endif
+      fflush(stdout);
+    }
+    if (buffered || fds[0].revents){
+      return;
+    }
+  }
+}
+
+/*
+ * drain_queue() - waits until every queued command (see submit) has been started and has
+ *                 finished, starting them as the queue's limits allow, for when the shell has no
+ *                 more input
+ *
+ * Parameters:
+ *  - sig_fd: the signalfd that SIGCHLD is read from, -1 if there is none (with -c)
+ *  - j_list: a job_list_t representing the list of current background jobs, contatining job ID,
+ *            process ID, command, and state
+ *  - jid: an int* representing the current job id, which gets incremented by 1 on each new job
+ *
+ * Returns:
+ *	- nothing (void)
+ */
+void drain_queue(int sig_fd, job_list_t* j_list, int* jid){
+  while(queue != NULL && queue_pending(queue)){
+    dispatch_queue(j_list, jid);
+    struct pollfd fds[2];
+    fds[0].fd = sig_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = get_job_epoll_fd(j_list);
+    fds[1].events = POLLIN;
+    /* a job without a pidfd only shows up on the signalfd, which -c doesn't have */
+    int timeout = queue_retry_ms(queue);
+    if (sig_fd == -1 && has_untracked_jobs(j_list)){
+      timeout = 100;
+    }
+    if (poll(fds, 2, timeout) == -1){
+      if (errno == EINTR){
+        continue;
+      }
+      perror("poll");
+      cleanup_job_list(j_list);
+      exit(1);
+    }
+    if (fds[0].revents & POLLIN){
+      struct signalfd_siginfo sig_info;
+      while (read(sig_fd, &sig_info, sizeof(sig_info)) > 0){
+      }
+    }
+    reap(j_list);
+    reap_exited(j_list);
+    fflush(stdout);
+  }
+}
+
+/* 1 if the token at i is a word to expand as a glob pattern, one naming a redirection's file is
+   taken as it is */
+static int is_expanded(token_t* tokens, int i){
+  return tokens[i].type == TOKEN_WORD && tokens[i].pattern != NULL
+    && (i == 0 || (tokens[i - 1].type != TOKEN_INPUT && tokens[i - 1].type != TOKEN_OUTPUT
+    && tokens[i - 1].type != TOKEN_APPEND)) && is_glob_pattern(tokens[i].pattern);
+}
+
+/*
+ * expand_patterns() - replaces each word of a command that is a glob pattern (see glob.h) with the
+ *                     paths it matches, in order, a pattern matching none being left as it is
+ *
+ * Parameters:
+ *  - tokens: a token_t** to the command's tokens, replaced with an array from arena if any word
+ *            is expanded
+ *  - num_tokens: an int* to the number of tokens, updated along with them
+ *  - arena: the arena_t* the line is parsed into, for the matches
+ *
+ * Returns:
+ *	- an integer, 0 on success, -1 if out of memory
+ */
+int expand_patterns(token_t** tokens, int* num_tokens, arena_t* arena){
+  /* most commands have no pattern, which costs a look at each token */
+  token_t* words = *tokens;
+  int num_words = *num_tokens;
+  int first = 0;
+  while (first < num_words && !is_expanded(words, first)){
+    first++;
+  }
+  if (first == num_words){
+    return 0;
+  }
+  double start = TRACE_ON ? trace_now() : 0;
+  char*** matches = (char***) arena_alloc(arena, (size_t) num_words * sizeof(char**));
+  size_t* num_matches = (size_t*) arena_alloc(arena, (size_t) num_words * sizeof(size_t));
+  if (matches == NULL || num_matches == NULL){
+    return -1;
+  }
+  size_t total = 0;
+  for(int i = 0; i < num_words; i++){
+    num_matches[i] = 0;
+    if (i >= first && is_expanded(words, i)
+        && expand_glob(words[i].pattern, arena, &matches[i], &num_matches[i]) == -1){
+      return -1;
+    }
+    total += num_matches[i] ? num_matches[i] : 1;
+  }
+  token_t* expanded = (token_t*) arena_alloc(arena, total * sizeof(token_t));
+  if (expanded == NULL){
+    return -1;
+  }
+  size_t n = 0;
+  for(int i = 0; i < num_words; i++){
+    if (!num_matches[i]){
+      expanded[n++] = words[i];
+    }
+    for(size_t j = 0; j < num_matches[i]; j++){
+      expanded[n].type = TOKEN_WORD;
+      expanded[n].text = matches[i][j];
+      expanded[n].pattern = NULL;
+      n++;
+    }
+  }
+  if (TRACE_ON){
+    trace_span("glob", start, 0, words[first].pattern);
+  }
+  *tokens = expanded;
+  *num_tokens = (int) total;
+  return 0;
+}
+
+/*
+ * run_list_command() - runs one command of a command list (see parser.c), a pipeline which may
+ *                      start with "time", as a builtin or as a job
+ *
+ * Parameters:
+ *  - command: the list_command_t* to run, with its tokens and whether it is run in the
+ *             background
+ *  - arena: the arena_t* the line is parsed into, for the command's stages and arguments
+ *  - reader: the line_reader_t* standard input is read through, synced before a child runs (NULL
+ *            with -c, when the shell reads no input)
+ *  - j_list: a job_list_t representing the list of current background jobs, contatining job ID,
+ *            process ID, command, and state
+ *  - jid: an int* representing the current job id, which gets incremented by 1 on each new job
+ *
+ * Returns:
+ *	- the exit status of the command (see exit_status()), 0 for a background job, and 2 if it
+ *    could not be parsed (which has been printed)
+ */
+int run_list_command(list_command_t* command, arena_t* arena, line_reader_t* reader,
+  job_list_t* j_list, int* jid){
+  token_t* tokens = command->tokens;
+  int num_tokens = command->num_tokens;
+  int background_process = command->background;
+  /* a leading "time" times the rest of the command (see print_time()) */
+  int timed = 0;
+  if (tokens[0].type == TOKEN_WORD && !strcmp(tokens[0].text, "time")){
+    timed = 1;
+    tokens++;
+    num_tokens--;
+    if (!num_tokens){
+      fprintf(stderr, "time: no command\n");
+      return 2;
+    }
+  }
+  if (timed && background_process){
+    fprintf(stderr, "time: can't time a background job\n");
+    return 2;
+  }
+  if (timed && refused_in_session("time")){
+    return 2;
+  }
+  /* then a leading "cpus=LIST" runs the job on just those CPUs, whatever the placement policy */
+  cpu_set_t cpus;
+  int pinned = 0;
+  if (tokens[0].type == TOKEN_WORD && !strncmp(tokens[0].text, "cpus=", 5)){
+    if (parse_cpu_list(tokens[0].text + 5, &cpus) == -1){
+      fprintf(stderr, "%s: not a list of CPUs\n", tokens[0].text);
+      return 2;
+    }
+    pinned = 1;
+    tokens++;
+    num_tokens--;
+    if (!num_tokens){
+      fprintf(stderr, "cpus: no command\n");
+      return 2;
+    }
+  }
+  /* the patterns among its words are expanded when it runs, after what ran before it */
+  if (expand_patterns(&tokens, &num_tokens, arena) == -1){
+    fprintf(stderr, "ERROR - Out of memory.\n");
+    return 1;
+  }
+  /* splits the tokens into the stages of a pipeline at each "|", and builds each stage's
+     launch and arguments (all of them stored in cmd_args, each followed by NULL) */
+  int num_stages = 1;
+  for(int i = 0; i < num_tokens; i++){
+    num_stages += (tokens[i].type == TOKEN_PIPE);
+  }
+  launch_t* stages = (launch_t*) arena_alloc(arena, (size_t) num_stages * sizeof(launch_t));
+  char** cmd_args = (char**) arena_alloc(arena, (size_t) (num_tokens + 1) * sizeof(char*));
+  if (stages == NULL || cmd_args == NULL){
+    fprintf(stderr, "ERROR - Out of memory.\n");
+    return 1;
+  }
+  int num_args = 0;
+  int stage_error = 0;
+  int start = 0;
+  for(int i = 0, s = 0; i <= num_tokens && !stage_error; i++){
+    if (i < num_tokens && tokens[i].type != TOKEN_PIPE){
+      continue;
+    }
+    int stage_args = build_stage(i - start, &tokens[start], &cmd_args[start], &stages[s]);
+    if (stage_args == -1){
+      stage_error = 1;
+    }
+    num_args = stage_args;
+    start = i + 1;
+    s++;
+  }
+  if (stage_error){
+    return 2;
+  }
+  if (pinned){
+    stages[0].cpus = &cpus;
+  }
+  /* notes the time and the shell's own usage before running a timed command */
+  timing_t timing;
+  timing_t* timing_ptr = NULL;
+  struct timespec start_time;
+  struct rusage start_usage;
+  if (timed){
+    timing.waited = 0;
+    timing_ptr = &timing;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    getrusage(RUSAGE_SELF, &start_usage);
+  }
+  /* parse for builtins and execute if exists, a pipeline runs every stage as a child */
+  int status = -1;
+  if (num_stages == 1){
+    builtin_reader = reader;
+    status = run_command(num_args, cmd_args, &stages[0], background_process, j_list, jid,
+      timing_ptr);
+    builtin_reader = NULL;
+  }
+  if (status == -1){
+    /* no builtins, then try to execute shild process, which may read the rest of the input,
+       so the input's offset is moved back to the first line not yet run */
+    if (reader != NULL && sync_line_reader(reader) == -1){
+      perror("lseek");
+    }
+    status = run_child_process(stages, num_stages, background_process, j_list, jid, timing_ptr);
+  }
+  if (timed){
+    print_time(&start_time, &start_usage, &timing);
+  }
+  return status;
+}
+
+/*
+ * run_commands() - runs the commands of a command list in order from first, each one after "&&"
+ *                  only if the last one run succeeded, and after "||" only if it failed
+ *
+ * Parameters:
+ *  - cmd_list: the command_list_t* to run
+ *  - first: the index of the first command to run
+ *  - arena: the arena_t* the list was parsed into
+ *  - reader: the line_reader_t* standard input is read through (NULL with -c or --server)
+ *  - j_list: a job_list_t representing the list of current background jobs, contatining job ID,
+ *            process ID, command, and state
+ *  - jid: an int* representing the current job id, which gets incremented by 1 on each new job
+ *
+ * Returns:
+ *	- an integer, the index of the next command to run, which is num_commands once they have all
+ *    run, or less if a server session is to wait for its foreground job first (or has exited)
+ */
+int run_commands(command_list_t* cmd_list, int first, arena_t* arena, line_reader_t* reader,
+  job_list_t* j_list, int* jid){
+  for(int i = first; i < cmd_list->num_commands; i++){
+    list_command_t* command = &cmd_list->commands[i];
+    if (i > 0 && ((command->op == LIST_AND && last_status != 0)
+        || (command->op == LIST_OR && last_status == 0))){
+      continue;
+    }
+    last_status = run_list_command(command, arena, reader, j_list, jid);
+    if (session != NULL && (session->waiting_jid != -1 || session->input_done)){
+      return i + 1;
+    }
+  }
+  return cmd_list->num_commands;
+}
+
+/*
+ * run_line() - parses a line into a command list and runs its commands in order, each one after
+ *              "&&" only if the last one run succeeded, and after "||" only if it failed
+ *
+ * Parameters:
+ *  - line: the line, which is tokenized in place
+ *  - arena: the arena_t* to parse the line into, reset first
+ *  - reader: the line_reader_t* standard input is read through (NULL with -c)
+ *  - j_list: a job_list_t representing the list of current background jobs, contatining job ID,
+ *            process ID, command, and state
+ *  - jid: an int* representing the current job id, which gets incremented by 1 on each new job
+ *
+ * Returns:
+ *	- nothing (void) - last_status is set to the status of the last command run, or to 2 if the
+ *    line could not be parsed, in a server session that waits for a job the rest of the line is
+ *    kept in the session
+ */
+void run_line(char* line, arena_t* arena, line_reader_t* reader, job_list_t* j_list, int* jid){
+  /* splits the line into tokens, if just whitespace there is nothing to run */
+  double parse_start = TRACE_ON ? trace_now() : 0;
+  reset_arena(arena);
+  /* parallel may read the lines after its own through the reader (see builtin_parallel()), which
+     can refill or unmap the memory this line and so its tokens are in, so a line that may run it
+     is run from a copy */
+  if (reader != NULL && strstr(line, "parallel") != NULL){
+    size_t size = strlen(line) + 1;
+    char* copy = (char*) arena_alloc(arena, size);
+    if (copy == NULL){
+      fprintf(stderr, "ERROR - Out of memory.\n");
+      last_status = 1;
+      return;
+    }
+    line = (char*) memcpy(copy, line, size);
+  }
+  token_list_t tok_list;
+  init_token_list(&tok_list, arena);
+  if (lex_line(&tok_list, line) == -1){
+    if (errno == EINVAL){
+      fprintf(stderr, "ERROR - Unterminated quote.\n");
+      last_status = 2;
+      return;
+    }
+    perror("lex_line");
+    cleanup_job_list(j_list);
+    exit(1);
+  }
+  int num_tokens = (int) tok_list.num_tokens;
+  token_t* tokens = tok_list.tokens;
+  if (!num_tokens){
+    return;
+  }
+  command_list_t cmd_list;
+  if (parse_list(&cmd_list, tokens, num_tokens, arena) == -1){
+    last_status = 2;
+    return;
+  }
+  if (TRACE_ON){
+    trace_span("parse", parse_start, 0, tokens[0].text);
+  }
+  int next = run_commands(&cmd_list, 0, arena, reader, j_list, jid);
+  /* a session waiting for a job goes on with the rest of the line later, from its arena */
+  if (session != NULL && next < cmd_list.num_commands && !session->input_done){
+    session->commands = cmd_list;
+    session->next_command = next;
+  }
+}
+
+/* the server's own standard output and error, which are put back once a session is served */
+static int server_out = -1;
+static int server_err = -1;
+
+/* flushes a stream to a session's socket, a client that has gone away leaves nothing behind in
+   the buffer for the next session, nor an error that would stop the server */
+void flush_session_stream(FILE* stream){
+  if (fflush(stream) == EOF){
+    __fpurge(stream);
+  }
+  clearerr(stream);
+}
+
+/*
+ * enter_session() - starts serving a session: the client's socket becomes the shell's standard
+ *                   output and error, which children inherit, so their output goes to the
+ *                   client without passing through the shell, and the session's working
+ *                   directory, last status and queue become the shell's
+ *
+ * Parameters:
+ *  - s: the session_t* to serve
+ *
+ * Returns:
+ *	- nothing (void)
+ */
+void enter_session(session_t* s){
+  flush_session_stream(stdout);
+  flush_session_stream(stderr);
+  if (dup2(s->fd, STDOUT_FILENO) == -1 || dup2(s->fd, STDERR_FILENO) == -1){
+    perror("dup2");
+  }
+  if (fchdir(s->cwd) == -1){
+    perror("fchdir");
+  }
+  last_status = s->last_status;
+  queue = s->queue;
+  session = s;
+}
+
+/* stops serving the session entered last, which keeps the shell's last status and queue */
+void leave_session(){
+  flush_session_stream(stdout);
+  flush_session_stream(stderr);
+  session->last_status = last_status;
+  session->queue = queue;
+  dup2(server_out, STDOUT_FILENO);
+  dup2(server_err, STDERR_FILENO);
+  session = NULL;
+  queue = NULL;
+}
+
+/* reap() for the server, each change being reported to the session whose job changed */
+void serve_reap(){
+  int options = WSTOPPED | WCONTINUED | WNOHANG;
+  for (session_t* s = get_sessions(); s != NULL; s = s->next){
+    if (has_untracked_jobs(s->jobs)){
+      options |= WEXITED;
+      break;
+    }
+  }
+  while(1){
+    siginfo_t info;
+    struct rusage usage;
+    info.si_pid = 0;
+    if (waitid_usage(P_ALL, 0, &info, options, &usage) == -1 || info.si_pid == 0){
+      return;
+    }
+    session_t* owner = find_session(info.si_pid);
+    if (owner == NULL){
+      if (TRACE_ON){
+        trace_status(info.si_pid, siginfo_status(&info));
+      }
+      continue;
+    }
+    enter_session(owner);
+    report_change(owner->jobs, info.si_pid, siginfo_status(&info), &usage);
+    leave_session();
+  }
+}
+
+/* 1 if a session can go on without waiting: it has the rest of a line to run, once its foreground
+   job is done, or a whole line already read, 0 else */
+int session_ready(session_t* s){
+  if (s->waiting_jid != -1 || s->input_done){
+    return 0;
+  }
+  return s->next_command != -1 || has_buffered_line(s->reader);
+}
+
+/*
+ * serve_session() - goes on with a session: runs the rest of its line and the lines it has sent
+ *                   until one of them waits for a foreground job or no whole line is left to
+ *                   read, then starts what its queue allows
+ *
+ * Parameters:
+ *  - s: the session_t* to serve
+ *
+ * Returns:
+ *	- nothing (void) - at the end of the client's input (or on exit) input_done is set
+ */
+void serve_session(session_t* s){
+  enter_session(s);
+  if (s->next_command != -1 && s->waiting_jid == -1){
+    int next = run_commands(&s->commands, s->next_command, s->arena, NULL, s->jobs, &s->jid);
+    s->next_command = next < s->commands.num_commands && !s->input_done ? next : -1;
+  }
+  while(s->next_command == -1 && s->waiting_jid == -1 && !s->input_done){
+    size_t count;
+    char* line = read_line(s->reader, &count);
+    if (line == NULL){
+      /* no whole line yet, or the client is done sending */
+      if (errno != EAGAIN){
+        s->input_done = 1;
+      }
+      break;
+    }
+    if (count){
+      run_line(line, s->arena, NULL, s->jobs, &s->jid);
+    }
+  }
+  if (queue != NULL){
+    dispatch_queue(s->jobs, &s->jid);
+  }
+  leave_session();
+}
+
+/* 1 if a session is over: the client has sent all its lines, and they have run, along with every
+   job and submitted command it started, 0 else */
+int session_done(session_t* s){
+  return s->input_done && s->waiting_jid == -1 && !get_num_jobs(s->jobs)
+    && (s->queue == NULL || !queue_pending(s->queue));
+}
+
+/*
+ * serve() - runs the shell as a server (33sh --server path), which serves any number of client
+ *           sessions at once from one poll() loop: a session reads its lines from its socket
+ *           without blocking, and a foreground job parks it rather than the loop, the session
+ *           going on with its line once the job is reaped
+ *
+ * Parameters:
+ *  - path: the path of the Unix socket to listen on
+ *
+ * Returns:
+ *	- an integer, the status to exit with: 0 once stopped by SIGINT, SIGTERM or SIGHUP (which
+ *    remove the socket), 1 if the server could not be started or failed
+ */
+int serve(const char* path){
+  int server_fd = open_server(path);
+  if (server_fd == -1){
+    perror(path);
+    return 1;
+  }
+  /* children read nothing from the server's own input, the sessions' sockets only carry lines */
+  int null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+  if (null_fd == -1 || dup2(null_fd, STDIN_FILENO) == -1){
+    perror("/dev/null");
+    close_server();
+    return 1;
+  }
+  close(null_fd);
+  server_out = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+  server_err = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 0);
+  /* stdout is written once per session served, when it is left, and a client that goes away
+     must not take the server with it */
+  setvbuf(stdout, NULL, _IOFBF, BUFSIZ);
+  signal(SIGPIPE, SIG_IGN);
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGCHLD);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+  sigaddset(&mask, SIGHUP);
+  int sig_fd = -1;
+  if (server_out == -1 || server_err == -1 || sigprocmask(SIG_BLOCK, &mask, NULL) == -1
+      || (sig_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC)) == -1){
+    perror("serve");
+    close_server();
+    return 1;
+  }
+  /* the listening socket, the signalfd, and each session's socket and pidfd epoll fd */
+  struct pollfd* fds = NULL;
+  session_t** polled = NULL;
+  size_t capacity = 0;
+  int status = -1;
+  while(status == -1){
+    int num_sessions = get_num_sessions();
+    size_t num_fds = 2 + 2 * (size_t) num_sessions;
+    if (num_fds > capacity){
+      struct pollfd* new_fds = (struct pollfd*) realloc(fds, num_fds * 2 * sizeof(struct pollfd));
+      fds = new_fds != NULL ? new_fds : fds;
+      session_t** new_polled = (session_t**) realloc(polled, num_fds * 2 * sizeof(session_t*));
+      polled = new_polled != NULL ? new_polled : polled;
+      if (new_fds == NULL || new_polled == NULL){
+        fprintf(stderr, "ERROR - Out of memory.\n");
+        status = 1;
+        break;
+      }
+      capacity = num_fds * 2;
+    }
+    fds[0].fd = server_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = sig_fd;
+    fds[1].events = POLLIN;
+    /* a session waiting for a job, or with input to run already, has its socket skipped */
+    int timeout = -1;
+    int i = 0;
+    for (session_t* s = get_sessions(); s != NULL; s = s->next, i++){
+      polled[i] = s;
+      struct pollfd* fd = &fds[2 + 2 * i];
+      fd[0].fd = s->waiting_jid == -1 && s->next_command == -1 && !s->input_done ? s->fd : -1;
+      fd[0].events = POLLIN;
+      fd[1].fd = get_job_epoll_fd(s->jobs);
+      fd[1].events = POLLIN;
+      int retry = s->queue != NULL ? queue_retry_ms(s->queue) : -1;
+      if (retry != -1 && (timeout == -1 || retry < timeout)){
+        timeout = retry;
+      }
+    }
+    if (poll(fds, num_fds, timeout) == -1){
+      if (errno == EINTR){
+        continue;
+      }
+      perror("poll");
+      status = 1;
+      break;
+    }
+    if (fds[1].revents & POLLIN){
+      struct signalfd_siginfo sig_info;
+      while (read(sig_fd, &sig_info, sizeof(sig_info)) > 0){
+        if (sig_info.ssi_signo != SIGCHLD){
+          status = 0;
+        }
+      }
+      if (status != -1){
+        break;
+      }
+      serve_reap();
+    }
+    for (i = 0; i < num_sessions; i++){
+      session_t* s = polled[i];
+      struct pollfd* fd = &fds[2 + 2 * i];
+      if (fd[1].revents & POLLIN){
+        enter_session(s);
+        reap_exited(s->jobs);
+        leave_session();
+      }
+      if (fd[0].revents || session_ready(s) || s->queue != NULL){
+        serve_session(s);
+      }
+      if (session_done(s)){
+        close_session(s);
+      }
+    }
+    if (fds[0].revents & POLLIN){
+      while (accept_session() != NULL){
+      }
+    }
+  }
+  while (get_sessions() != NULL){
+    close_session(get_sessions());
+  }
+  free(fds);
+  free(polled);
+  close(sig_fd);
+  close_server();
+  return status;
+}
+
+/* executes shell, "33sh -c command" runs just the command and exits with its status, and
+   "33sh --server path" serves clients on a Unix socket until it is stopped (see serve()) */
+int main(int argc, char** argv) {
+  char* command = NULL;
+  char* server_path = NULL;
+  if (argc > 1){
+    if (argc == 3 && !strcmp(argv[1], "-c")){
+      command = argv[2];
+    } else if (argc == 3 && !strcmp(argv[1], "--server")){
+      server_path = argv[2];
+    } else {
+      fprintf(stderr, "usage: %s [-c command | --server path]\n", argv[0]);
+      exit(2);
+    }
+  }
+  /* a shell that reads no terminal does no job control on one, so it skips ignoring the
+     terminal's signals here, and every tcsetpgrp() later on */
+  interactive = command == NULL && server_path == NULL && isatty(STDIN_FILENO);
+  /* instantiates job list and job id */
+  job_list_t* j_list = init_job_list();
+  int jid = 0;
+  /* starts tracing if SH33_TRACE or SH33_TRACE_FD is set (see trace.c) */
+  if (init_trace() == -1){
+    perror("trace");
+  }
+  /* forks the zygote if SH33_ZYGOTE is set (see zygote.h), now while the shell is small and
+     before it ignores any signals, -c runs too few commands for it to pay off */
+  if (command == NULL && init_zygote() == -1){
+    perror("zygote");
+  }
+  /* each session of a server has a job list of its own */
+  if (server_path != NULL){
+    cleanup_job_list(j_list);
+    int status = serve(server_path);
+    cleanup_path_cache();
+    exit(status);
+  }
+  /* ignore these signals in the shell */
+  if (interactive){
+    if (signal(SIGINT, SIG_IGN) == SIG_ERR){
+      perror("signal");
+      cleanup_job_list(j_list);
+      exit(1);
+    }
+    if (signal(SIGTSTP, SIG_IGN) == SIG_ERR){
+      perror("signal");
+      cleanup_job_list(j_list);
+      exit(1);
+    }
+    if (signal(SIGQUIT, SIG_IGN) == SIG_ERR){
+      perror("signal");
+      cleanup_job_list(j_list);
+      exit(1);
+    }
+    if (signal(SIGTTOU, SIG_IGN) == SIG_ERR){
+      perror("signal");
+      cleanup_job_list(j_list);
+      exit(1);
+    }
+  }
+  /* everything parsed from a line (tokens, arguments, stages) is allocated from an arena that is
+     reset for each line, so once it is big enough the loop never goes to malloc */
+  arena_t* arena = init_arena(16384);
+  if (arena == NULL){
+    fprintf(stderr, "ERROR - Arena could not be created.\n");
+    cleanup_job_list(j_list);
+    exit(1);
+  }
+  if (command != NULL){
+    /* nothing is read from standard input and no job is reaped in the background, so there
+       is no reader or signalfd to set up, the jobs are waited for as they run */
+    run_line(command, arena, NULL, j_list, &jid);
+    drain_queue(-1, j_list, &jid);
+    cleanup_job_queue(queue);
+    cleanup_arena(arena);
+    cleanup_job_list(j_list);
+    cleanup_path_cache();
+    exit(last_status);
+  }
+  /* blocks SIGCHLD and reads it from a signalfd instead, so jobs are reaped when they change */
+  sigset_t sigchld_mask;
+  sigemptyset(&sigchld_mask);
+  sigaddset(&sigchld_mask, SIGCHLD);
+  if (sigprocmask(SIG_BLOCK, &sigchld_mask, NULL) == -1){
+    perror("sigprocmask");
+    cleanup_job_list(j_list);
+    exit(1);
+  }
+  int sig_fd = signalfd(-1, &sigchld_mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (sig_fd == -1){
+    perror("signalfd");
+    cleanup_job_list(j_list);
+    exit(1);
+  }
+  /* commands are read a line at a time from a buffer, so a script or a stream of commands takes
+     one read() (or one mmap()) for many lines */
+  line_reader_t* reader = init_line_reader(STDIN_FILENO);
+  if (reader == NULL){
+    fprintf(stderr, "ERROR - Input reader could not be created.\n");
+    cleanup_job_list(j_list);
+    exit(1);
+  }
+  /* create REPL loop */
+  while(1){
+    /* prompts user for input */
+    #ifdef PROMPT
+    if (interactive){
+      if (printf("33sh> ") < 0){
+        fprintf(stderr, "ERROR - Prompt did not print successfully.\n");
+        cleanup_job_list(j_list);
+        exit(1);
+      }
+      fflush(stdout);
+    }
+    #endif
+    /* waits for user input, reaping jobs as they change, then reads it in */
+    wait_for_input(sig_fd, j_list, reader, &jid);
+    size_t count;
+    char* buffer = read_line(reader, &count);
+    /* if user types ctrl-D, or the input ends, exits with the status of the last command */
+    if (buffer == NULL){
+      if (errno){
+        fprintf(stderr, "ERROR - Input not read successfully.\n");
+        cleanup_job_list(j_list);
+        exit(1);
+      }
+      /* submitted commands still get to run, the shell only exits once they are done */
+      drain_queue(sig_fd, j_list, &jid);
+      cleanup_job_queue(queue);
+      cleanup_line_reader(reader);
+      cleanup_arena(arena);
+      cleanup_job_list(j_list);
+      cleanup_path_cache();
+      exit(last_status);
+    }
+    /* if user types 'enter', and then the line is empty */
+    if (!count){
+      continue;
+    }
+    run_line(buffer, arena, reader, j_list, &jid);
+  }
+  return 0;
+}
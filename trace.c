@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include "trace.h"
+
+/* enough for any event, so each one is a single write(), which keeps the events of the shell
+   and of its children (which write to the same fd between fork() and exec) from interleaving */
+#define TRACE_EVENT_SIZE 1024
+/* detail strings are cut to this length */
+#define TRACE_DETAIL_SIZE 256
+
+int trace_fd = -1;
+
+/* writes buf in full, tracing is turned off if the trace can't be written */
+static void trace_write(const char *buf, size_t len){
+  while (len > 0){
+    ssize_t written = write(trace_fd, buf, len);
+    if (written == -1){
+      if (errno == EINTR){
+        continue;
+      }
+      trace_fd = -1;
+      return;
+    }
+    buf += written;
+    len -= (size_t) written;
+  }
+}
+
+int init_trace(){
+  const char *path = getenv("SH33_TRACE");
+  const char *fd_var = getenv("SH33_TRACE_FD");
+  if (path != NULL && *path != '\0'){
+    trace_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (trace_fd == -1){
+      return -1;
+    }
+  } else if (fd_var != NULL && *fd_var != '\0'){
+    char *end;
+    long fd = strtol(fd_var, &end, 10);
+    if (*end != '\0' || fd < 0 || fd > INT32_MAX){
+      errno = EBADF;
+      return -1;
+    }
+    /* the children must not inherit the fd, only the forked ones write to it before exec */
+    if (fcntl((int) fd, F_SETFD, FD_CLOEXEC) == -1){
+      return -1;
+    }
+    trace_fd = (int) fd;
+  } else {
+    return 0;
+  }
+  /* the Trace Event Format's JSON array, one event per line, which chrome://tracing and
+     Perfetto load even without the closing ']' */
+  trace_write("[\n", 2);
+  trace_instant("trace_start", getpid(), NULL);
+  return 0;
+}
+
+double trace_now(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec * 1e6 + (double) ts.tv_nsec / 1e3;
+}
+
+/* copies detail into buf as the contents of a JSON string, escaping what needs it */
+static void escape_detail(char *buf, size_t size, const char *detail){
+  size_t len = 0;
+  for (const char *c = detail; *c != '\0' && len + 7 < size; c++){
+    unsigned char ch = (unsigned char) *c;
+    if (ch == '"' || ch == '\\'){
+      buf[len++] = '\\';
+      buf[len++] = (char) ch;
+    } else if (ch < 0x20){
+      len += (size_t) snprintf(buf + len, size - len, "\\u%04x", ch);
+    } else {
+      buf[len++] = (char) ch;
+    }
+  }
+  buf[len] = '\0';
+}
+
+/* writes one event, phase 'i' for an instant and 'X' for a complete event of duration dur */
+static void trace_event(const char *name, char phase, double ts, double dur, pid_t pid,
+  const char *detail){
+  char escaped[TRACE_DETAIL_SIZE];
+  escape_detail(escaped, sizeof(escaped), detail != NULL ? detail : "");
+  /* the events of each process (the shell or a forked child) are on their own track */
+  int self = (int) getpid();
+  char buf[TRACE_EVENT_SIZE];
+  int len;
+  if (phase == 'X'){
+    len = snprintf(buf, sizeof(buf), "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+      "\"pid\":%d,\"tid\":%d,\"args\":{\"pid\":%d,\"detail\":\"%s\"}},\n", name, ts, dur, self,
+      self, (int) pid, escaped);
+  } else {
+    len = snprintf(buf, sizeof(buf), "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"p\",\"ts\":%.3f,"
+      "\"pid\":%d,\"tid\":%d,\"args\":{\"pid\":%d,\"detail\":\"%s\"}},\n", name, ts, self, self,
+      (int) pid, escaped);
+  }
+  if (len > 0){
+    trace_write(buf, (size_t) len < sizeof(buf) ? (size_t) len : sizeof(buf) - 1);
+  }
+}
+
+void trace_instant(const char *name, pid_t pid, const char *detail){
+  if (!TRACE_ON){
+    return;
+  }
+  trace_event(name, 'i', trace_now(), 0, pid, detail);
+}
+
+void trace_span(const char *name, double start, pid_t pid, const char *detail){
+  if (!TRACE_ON){
+    return;
+  }
+  double now = trace_now();
+  trace_event(name, 'X', start, now - start, pid, detail);
+}
@@ -0,0 +1,33 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <sys/types.h>
+
+/* the fd that trace events are written to, -1 while tracing is off */
+extern int trace_fd;
+
+/* true if tracing is on, every trace call is behind a test of this, so tracing costs one
+   predictable branch when it is off */
+#define TRACE_ON (trace_fd != -1)
+
+/*
+ * starts tracing if the environment asks for it, SH33_TRACE naming a file to write the trace to,
+ * or SH33_TRACE_FD an fd that is already open (e.g. "SH33_TRACE_FD=9 ./33sh 9>trace.json")
+ * returns 0 on success (tracing on or not), -1 on failure with errno set
+ */
+int init_trace();
+
+/* gets the time that trace events are stamped with, in microseconds on CLOCK_MONOTONIC */
+double trace_now();
+
+/*
+ * writes an instant event, name happening now to process pid (0 for none), with an optional
+ * detail string (NULL for none)
+ */
+void trace_instant(const char *name, pid_t pid, const char *detail);
+
+/* writes a complete event, name lasting from start (from trace_now()) until now, with pid and
+   detail as for trace_instant() */
+void trace_span(const char *name, double start, pid_t pid, const char *detail);
+
+#endif  // TRACE_H_
@@ -0,0 +1,361 @@
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sched.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "zygote.h"
+#include "trace.h"
+
+/* the largest request (path and arguments), a longer command is launched by the shell itself */
+#define ZYGOTE_MAX_REQUEST 65536
+/* descriptors passed with each request: standard input, output and error, working directory */
+#define ZYGOTE_FDS 4
+/* the stack a child runs on until it execs */
+#define ZYGOTE_STACK 65536
+
+/* what the zygote is told about a child, followed in the same message by its path and its
+   arguments, each ending in '\0' */
+typedef struct zygote_request {
+  pid_t pgid;
+  int foreground;
+  int has_cpus;
+  cpu_set_t cpus;
+  int node;
+  int num_args;
+} zygote_request_t;
+
+/* what it answers, the child's pid (-1 if it was not cloned) and the error if it could not be
+   started, including a failed exec */
+typedef struct zygote_reply {
+  pid_t pid;
+  int error;
+} zygote_reply_t;
+
+/* a request with room for its strings, aligned for the header */
+typedef union zygote_message {
+  zygote_request_t request;
+  char bytes[ZYGOTE_MAX_REQUEST];
+} zygote_message_t;
+
+/* the shell's end of the socket and the zygote's pid, sock being -1 with no zygote */
+static struct {
+  int sock;
+  pid_t pid;
+} zygote = {-1, -1};
+
+static zygote_message_t message;
+
+/* what a child is started from, error being set by the child if it fails */
+typedef struct zygote_start {
+  zygote_request_t *request;
+  const char *path;
+  char **argv;
+  int *fds;
+  int error;
+} zygote_start_t;
+
+static long child_stack[ZYGOTE_STACK / sizeof(long)];
+
+/*
+ * zygote_exec() - sets up a child cloned by the zygote and execs it, running in the zygote's
+ *                 memory and on child_stack while the zygote waits (as after vfork()), with
+ *                 every signal blocked until just before the exec, so tcsetpgrp() from its new
+ *                 background process group is not stopped by SIGTTOU
+ *
+ * Parameters:
+ *  - arg: the zygote_start_t* of the child, whose error it sets if it fails
+ *
+ * Returns:
+ *	- nothing, it execs or exits
+ */
+static int zygote_exec(void *arg){
+  zygote_start_t *start = (zygote_start_t *) arg;
+  zygote_request_t *request = start->request;
+  int *fds = start->fds;
+  if (setpgid(0, request->pgid) == -1){
+    goto fail;
+  }
+  if (request->foreground && tcsetpgrp(STDIN_FILENO, getpgrp()) == -1){
+    goto fail;
+  }
+  if (dup2(fds[0], STDIN_FILENO) == -1 || dup2(fds[1], STDOUT_FILENO) == -1
+      || dup2(fds[2], STDERR_FILENO) == -1 || fchdir(fds[3]) == -1){
+    goto fail;
+  }
+  /* a placement the kernel refuses leaves it with the zygote's CPUs, as launch_child() does */
+  if (request->has_cpus){
+    sched_setaffinity(0, sizeof(cpu_set_t), &request->cpus);
+  }
+  if (request->node != -1){
+    set_node_policy(request->node);
+  }
+  sigset_t sig_mask;
+  sigemptyset(&sig_mask);
+  sigprocmask(SIG_SETMASK, &sig_mask, NULL);
+  if (TRACE_ON){
+    trace_instant("child_ready", getpid(), start->path);
+  }
+  execv(start->path, start->argv);
+fail:
+  start->error = errno;
+  _exit(127);
+}
+
+/*
+ * zygote_launch() - launches the child of one request, returning once it has exec'd or failed,
+ *                   like posix_spawn()
+ *
+ * Parameters:
+ *  - length: the length of the request in message
+ *  - fds: the descriptors that came with it
+ *  - reply: the zygote_reply_t* to fill in
+ *
+ * Returns:
+ *	- nothing (void)
+ */
+static void zygote_launch(size_t length, int *fds, zygote_reply_t *reply){
+  zygote_request_t *request = &message.request;
+  reply->pid = -1;
+  reply->error = EINVAL;
+  /* the path and arguments, which must all be there */
+  char **argv = (char **) malloc((size_t) (request->num_args + 1) * sizeof(char *));
+  if (argv == NULL){
+    reply->error = ENOMEM;
+    return;
+  }
+  char *cur = message.bytes + sizeof(zygote_request_t);
+  char *end = message.bytes + length;
+  const char *path = cur;
+  for (int i = -1; i < request->num_args; i++){
+    char *nul = memchr(cur, '\0', (size_t) (end - cur));
+    if (nul == NULL){
+      free(argv);
+      return;
+    }
+    if (i >= 0){
+      argv[i] = cur;
+    }
+    cur = nul + 1;
+  }
+  argv[request->num_args] = NULL;
+
+  /* a vfork() whose child has the shell as its parent, the zygote goes on once the child has
+     exec'd or exited, with its error set if it failed */
+  zygote_start_t start = {request, path, argv, fds, 0};
+  sigset_t all, saved;
+  sigfillset(&all);
+  sigprocmask(SIG_SETMASK, &all, &saved);
+  pid_t pid = clone(zygote_exec, (char *) child_stack + sizeof(child_stack),
+    CLONE_PARENT | CLONE_VM | CLONE_VFORK | SIGCHLD, &start);
+  int error = errno;
+  sigprocmask(SIG_SETMASK, &saved, NULL);
+  free(argv);
+  reply->pid = pid;
+  reply->error = pid == -1 ? error : start.error;
+}
+
+/* the zygote's loop, which serves requests until the shell closes its end */
+static void zygote_loop(int sock){
+  while (1){
+    struct iovec iov = {message.bytes, sizeof(message.bytes)};
+    union {
+      struct cmsghdr header;
+      char bytes[CMSG_SPACE(ZYGOTE_FDS * sizeof(int))];
+    } control;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.bytes;
+    msg.msg_controllen = sizeof(control.bytes);
+    ssize_t length = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    if (length == -1 && errno == EINTR){
+      continue;
+    }
+    if (length <= 0){
+      _exit(0);
+    }
+    int fds[ZYGOTE_FDS];
+    int num_fds = 0;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS){
+      num_fds = (int) ((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+      memcpy(fds, CMSG_DATA(cmsg), (size_t) num_fds * sizeof(int));
+    }
+    zygote_reply_t reply = {-1, EINVAL};
+    if (num_fds == ZYGOTE_FDS && (size_t) length > sizeof(zygote_request_t)
+        && !(msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC))){
+      zygote_launch((size_t) length, fds, &reply);
+    }
+    for (int i = 0; i < num_fds; i++){
+      close(fds[i]);
+    }
+    if (send(sock, &reply, sizeof(reply), MSG_NOSIGNAL) == -1){
+      _exit(0);
+    }
+  }
+}
+
+int init_zygote(){
+  if (getenv("SH33_ZYGOTE") == NULL){
+    return 0;
+  }
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) == -1){
+    return -1;
+  }
+  pid_t shell = getpid();
+  pid_t pid = fork();
+  if (pid == -1){
+    close(fds[0]);
+    close(fds[1]);
+    return -1;
+  }
+  if (pid == 0){
+    /* it goes when the shell does, keeps out of the terminal's process group so no ^C or ^Z
+       reaches it, and has the dispositions every child needs */
+    close(fds[0]);
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (getppid() != shell){
+      _exit(0);
+    }
+    setpgid(0, 0);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTSTP, SIG_DFL);
+    signal(SIGQUIT, SIG_DFL);
+    signal(SIGTTOU, SIG_DFL);
+    signal(SIGPIPE, SIG_DFL);
+    zygote_loop(fds[1]);
+  }
+  close(fds[1]);
+  setpgid(pid, pid);
+  zygote.sock = fds[0];
+  zygote.pid = pid;
+  if (TRACE_ON){
+    trace_instant("zygote", pid, "started");
+  }
+  return 0;
+}
+
+int zygote_running(){
+  return zygote.sock != -1;
+}
+
+/* stops using the zygote, after it failed, reaping it if it is gone */
+static void stop_zygote(){
+  close(zygote.sock);
+  zygote.sock = -1;
+  kill(zygote.pid, SIGKILL);
+  waitpid(zygote.pid, NULL, 0);
+  zygote.pid = -1;
+}
+
+/* opens a redirection file for the child, as the spawn file actions would */
+static int open_redirect(const char *file, int options){
+  return open(file, options | O_CLOEXEC, 0666);
+}
+
+pid_t zygote_child(launch_t *launch, int *unavailable){
+  *unavailable = 0;
+  /* the request, which is sent as is */
+  zygote_request_t *request = &message.request;
+  request->pgid = launch->pgid;
+  request->foreground = launch->foreground;
+  request->has_cpus = launch->cpus != NULL;
+  if (launch->cpus != NULL){
+    request->cpus = *launch->cpus;
+  }
+  request->node = launch->node;
+  request->num_args = 0;
+  char *cur = message.bytes + sizeof(zygote_request_t);
+  char *end = message.bytes + sizeof(message.bytes);
+  for (int i = -1; i < 0 || launch->argv[i] != NULL; i++){
+    const char *string = i < 0 ? launch->path : launch->argv[i];
+    size_t length = strlen(string) + 1;
+    if (length > (size_t) (end - cur)){
+      *unavailable = 1;
+      return -1;
+    }
+    memcpy(cur, string, length);
+    cur += length;
+    request->num_args += (i >= 0);
+  }
+
+  /* the child's standard input, output and error and working directory, a redirection file
+     taking precedence over a pipe end as in spawn_setup() */
+  int fds[ZYGOTE_FDS] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO, -1};
+  int opened[3] = {-1, -1, -1};
+  if (launch->in_fd != -1){
+    fds[0] = launch->in_fd;
+  }
+  if (launch->out_fd != -1){
+    fds[1] = launch->out_fd;
+  }
+  if (launch->input != NULL){
+    fds[0] = opened[0] = open_redirect(launch->input, O_RDONLY);
+  }
+  if (launch->output != NULL && fds[0] != -1){
+    fds[1] = opened[1] = open_redirect(launch->output,
+      O_WRONLY | O_CREAT | (launch->append ? O_APPEND : O_TRUNC));
+  }
+  if (fds[0] != -1 && fds[1] != -1){
+    fds[3] = opened[2] = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+  }
+  pid_t pid = -1;
+  int error = errno;
+  if (fds[0] != -1 && fds[1] != -1 && fds[3] != -1){
+    double start = TRACE_ON ? trace_now() : 0;
+    struct iovec iov = {message.bytes, (size_t) (cur - message.bytes)};
+    union {
+      struct cmsghdr header;
+      char bytes[CMSG_SPACE(ZYGOTE_FDS * sizeof(int))];
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.bytes;
+    msg.msg_controllen = sizeof(control.bytes);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(ZYGOTE_FDS * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    zygote_reply_t reply;
+    ssize_t got = -1;
+    if (sendmsg(zygote.sock, &msg, MSG_NOSIGNAL) != -1){
+      while ((got = recv(zygote.sock, &reply, sizeof(reply), 0)) == -1 && errno == EINTR){
+      }
+    }
+    if (got != sizeof(reply)){
+      /* the zygote is gone (or broken), the shell launches its children itself from now on */
+      stop_zygote();
+      *unavailable = 1;
+    } else if (reply.error != 0){
+      /* a child that failed to exec has exited already, and is no job, so it is reaped here */
+      if (reply.pid > 0){
+        waitpid(reply.pid, NULL, 0);
+      }
+      error = reply.error;
+    } else {
+      pid = reply.pid;
+    }
+    if (TRACE_ON){
+      trace_span("zygote", start, pid == -1 ? 0 : pid, launch->path);
+    }
+  }
+  for (int i = 0; i < 3; i++){
+    if (opened[i] != -1){
+      close(opened[i]);
+    }
+  }
+  errno = error;
+  return pid;
+}
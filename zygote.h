@@ -0,0 +1,32 @@
+#ifndef ZYGOTE_H_
+#define ZYGOTE_H_
+
+#include <sys/types.h>
+#include "launch.h"
+
+/*
+ * The zygote is a helper process forked when the shell starts, while it is still small, with the
+ * job control signals already back to default, which launches children for the shell: it gets
+ * each one's path, arguments and placement over a Unix socket, and its standard input, output
+ * and error and working directory as descriptors (SCM_RIGHTS), then clones the child as vfork()
+ * would, sharing the zygote's memory until it execs, with CLONE_PARENT, so the child is the
+ * shell's own to wait for and signal as usual. How big the shell grows then never makes launching
+ * slower.
+ */
+
+/* starts the zygote if SH33_ZYGOTE is set in the environment, returns 0 on success or if no
+   zygote is wanted, -1 on failure (children are then launched by the shell itself) */
+int init_zygote();
+
+/* 1 if the zygote is running, 0 else */
+int zygote_running();
+
+/*
+ * launches the child through the zygote, as launch_child() would, sets unavailable to 1 if the
+ * zygote could not take it (it is gone, or the arguments are too long for one request), in which
+ * case the child should be launched some other way, 0 else
+ * returns the child's pid on success, -1 on failure with errno set
+ */
+pid_t zygote_child(launch_t *launch, int *unavailable);
+
+#endif  // ZYGOTE_H_